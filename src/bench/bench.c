@@ -0,0 +1,149 @@
+// Benchmark firmware: CPU cycles taken by the graphics and game hot paths.
+// Made by "make bench" and run in simavr by tools/bench.py, which turns the
+// output into a JSON report and compares it with a baseline.
+//
+// The game is linked in from tomjerry.c (built with -DGAME_NO_MAIN) and set
+// up on level 2 with fireworks in flight. Each kernel is timed call by call
+// with the game clock, less the cost of reading the clock, and reported on
+// the simavr console as
+//
+//     bench <name> <cycles per call> <calls>
+//
+// followed by "bench done". Only the Timer 3 overflow interrupt is enabled,
+// so the counts are the same on every run.
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <avr/sleep.h>
+#include <avr/avr_mcu_section.h>
+#include <cpu_speed.h>
+
+#include <hal.h>
+#include <graphics.h>
+#include <format.h>
+#include "../tomjerry.h"
+
+// Tell simavr the part and clock, and print what is written to GPIOR0
+AVR_MCU(F_CPU, "atmega32u4");
+AVR_MCU_SIMAVR_CONSOLE(&GPIOR0);
+
+#define FIREWORKS 8
+
+// Cycles taken by an empty measurement
+uint32_t overhead;
+
+void console_write(const char *start, const char *end)
+{
+    while (start < end)
+    {
+        GPIOR0 = *start++;
+    }
+}
+
+// One report line; name is in flash
+void report(const char *name, uint32_t total, uint16_t calls)
+{
+    char line[48];
+    char *end = FMT_END(line);
+    char *p = fmt_str_P(line, end, PSTR("bench "));
+    p = fmt_str_P(p, end, name);
+    p = fmt_str_P(p, end, PSTR(" "));
+    p = fmt_uint(p, end, total / calls, 0);
+    p = fmt_str_P(p, end, PSTR(" "));
+    p = fmt_uint(p, end, calls, 0);
+    p = fmt_str_P(p, end, PSTR("\n"));
+    console_write(line, p);
+}
+
+// Time kernel over calls runs. setup runs before each one and is not timed.
+#define BENCH(name, calls, setup, kernel)                    \
+    do                                                       \
+    {                                                        \
+        uint32_t total = 0;                                  \
+        for (uint16_t n = 0; n < (calls); n++)               \
+        {                                                    \
+            setup;                                           \
+            uint32_t start = clock_cycles();                 \
+            kernel;                                          \
+            total += clock_cycles() - start - overhead;      \
+        }                                                    \
+        report(PSTR(name), total, calls);                    \
+    } while (0)
+
+// Fill screen_buffer directly. The dirty tracking does not see writes that
+// bypass the drawing functions, so mark the whole screen as changed.
+void fill_screen(uint8_t pattern)
+{
+    memset(screen_buffer, pattern, LCD_BUFFER_SIZE);
+    invalidate_screen();
+}
+
+void calibrate(void)
+{
+    overhead = UINT32_MAX;
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        uint32_t start = clock_cycles();
+        uint32_t cycles = clock_cycles() - start;
+        if (cycles < overhead)
+        {
+            overhead = cycles;
+        }
+    }
+}
+
+int main(void)
+{
+    set_clock_speed(CPU_8MHz);
+    lcd_init(LCD_DEFAULT_CONTRAST);
+
+    current_level = 2;
+    setup_vars();
+    randomize_tom();
+    for (uint8_t i = 0; i < FIREWORKS; i++)
+    {
+        shoot_firework();
+    }
+
+    hal_clock_start();
+    sei();
+    calibrate();
+
+    char text[] = "Score: 12 Lives: 3";
+
+    // Graphics
+    BENCH("clear_screen", 100, , clear_screen());
+    BENCH("show_screen_full", 10, fill_screen(n & 1 ? 0x55 : 0xAA), show_screen());
+    BENCH("show_screen_unchanged", 100, , show_screen());
+    BENCH("draw_pixel", 100, , draw_pixel(n % LCD_X, n % LCD_Y, FG_COLOUR));
+    BENCH("draw_line_horizontal", 100, , draw_line(0, 20, LCD_X - 1, 20, FG_COLOUR));
+    BENCH("draw_line_vertical", 100, , draw_line(40, 0, 40, LCD_Y - 1, FG_COLOUR));
+    BENCH("draw_line_diagonal", 100, , draw_line(0, 0, LCD_X - 1, LCD_Y - 1, FG_COLOUR));
+    BENCH("draw_char", 100, , draw_char(n % LCD_X, n % LCD_Y, 'A' + n % 26, FG_COLOUR));
+    BENCH("draw_string", 100, , draw_string(0, 0, text, FG_COLOUR));
+
+    // Game
+    BENCH("move_walls", 100, , move_walls());
+    BENCH("update_enemy", 100, , update_enemy());
+    BENCH("update_fireworks", 100, , update_fireworks());
+    BENCH("step", 100, , step());
+    BENCH("render", 100, , render());
+    BENCH("frame", 100, , {
+        step();
+        render();
+    });
+
+    char done[] = "bench done\n";
+    console_write(done, done + sizeof(done) - 1);
+
+    // Sleeping with interrupts off ends the simulation
+    cli();
+    sleep_mode();
+    for (;;)
+    {
+    }
+}
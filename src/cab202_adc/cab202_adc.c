@@ -9,6 +9,9 @@
 
 #include "cab202_adc.h"
 
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
 /*
 **	Initialize and enable ADC with pre-scaler 128.
 **
@@ -34,12 +37,17 @@ void adc_init() {
 **	1 = Pot1
 **	4 = Broken-out Pin F4.
 */
-uint16_t adc_read(uint8_t channel) {
+static void adc_select(uint8_t channel) {
 	// Select AVcc voltage reference and pin combination.
 	// Low 5 bits of channel spec go in ADMUX(MUX4:0)
-	// 5th bit of channel spec goes in ADCSRB(MUX5).
+	// 5th bit of channel spec goes in ADCSRB(MUX5), leaving the trigger
+	// source in ADCSRB(ADTS2:0) alone.
 	ADMUX = (channel & ((1 << 5) - 1)) | (1 << REFS0);
-	ADCSRB = (channel & (1 << 5));
+	ADCSRB = (ADCSRB & ~(1 << 5)) | (channel & (1 << 5));
+}
+
+uint16_t adc_read(uint8_t channel) {
+	adc_select(channel);
 
 	// Start single conversion by setting ADSC bit in ADCSRA
 	ADCSRA |= (1 << ADSC);
@@ -51,3 +59,136 @@ uint16_t adc_read(uint8_t channel) {
 	return ADC;
 }
 
+
+/*
+**	Background sampling state. adc_slot is the index in adc_channels of
+**	the conversion in progress.
+*/
+static uint8_t adc_channels[ADC_MAX_CHANNELS];
+static uint8_t adc_count = 0;
+static volatile uint8_t adc_slot;
+static uint8_t adc_continuous;
+static volatile uint16_t adc_values[ADC_MAX_CHANNELS];
+
+#if ADC_MEDIAN
+static uint16_t adc_history[ADC_MAX_CHANNELS][2];
+#endif
+
+#if ADC_IIR_SHIFT > 0
+// Filter state, scaled up by 2^ADC_IIR_SHIFT to keep the fraction.
+static uint16_t adc_iir[ADC_MAX_CHANNELS];
+#endif
+
+static uint16_t median3(uint16_t a, uint16_t b, uint16_t c) {
+	if ( a > b ) {
+		uint16_t t = a;
+		a = b;
+		b = t;
+	}
+	// Now a <= b: the median is b clamped to c, then raised to a.
+	if ( c < b ) {
+		b = c;
+	}
+	return b < a ? a : b;
+}
+
+/*
+**	Pass a new sample for slot i through the filters and store it.
+*/
+static void adc_store(uint8_t i, uint16_t sample) {
+#if ADC_MEDIAN
+	uint16_t oldest = adc_history[i][0];
+	adc_history[i][0] = adc_history[i][1];
+	adc_history[i][1] = sample;
+	sample = median3(oldest, adc_history[i][0], sample);
+#endif
+
+#if ADC_IIR_SHIFT > 0
+	adc_iir[i] += sample - (adc_iir[i] >> ADC_IIR_SHIFT);
+	sample = adc_iir[i] >> ADC_IIR_SHIFT;
+#endif
+
+	adc_values[i] = sample;
+}
+
+void adc_start(const uint8_t *channels, uint8_t count, uint8_t trigger) {
+	adc_stop();
+
+	if ( count > ADC_MAX_CHANNELS ) {
+		count = ADC_MAX_CHANNELS;
+	}
+
+	// Seed each channel's value and filters with one blocking read.
+	for ( uint8_t i = 0; i < count; i++ ) {
+		uint16_t sample = adc_read(channels[i]);
+		adc_channels[i] = channels[i];
+		adc_values[i] = sample;
+#if ADC_MEDIAN
+		adc_history[i][0] = adc_history[i][1] = sample;
+#endif
+#if ADC_IIR_SHIFT > 0
+		adc_iir[i] = sample << ADC_IIR_SHIFT;
+#endif
+	}
+
+	if ( count == 0 ) {
+		return;
+	}
+
+	adc_count = count;
+	adc_slot = 0;
+	adc_select(adc_channels[0]);
+	adc_continuous = trigger == ADC_TRIGGER_CONTINUOUS;
+
+	// Writing 1 to ADIF clears the flag left by the seeding reads, so the
+	// interrupt does not fire before the first background conversion.
+	if ( adc_continuous ) {
+		ADCSRA |= (1 << ADIF) | (1 << ADIE) | (1 << ADSC);
+	}
+	else {
+		ADCSRB = (ADCSRB & ~((1 << ADTS2) | (1 << ADTS1) | (1 << ADTS0))) | (trigger & 0b111);
+		ADCSRA |= (1 << ADIF) | (1 << ADIE) | (1 << ADATE);
+	}
+}
+
+void adc_stop() {
+	ADCSRA &= ~((1 << ADIE) | (1 << ADATE));
+
+	// Let a conversion already under way finish.
+	while ( ADCSRA & (1 << ADSC) ) {}
+
+	adc_count = 0;
+}
+
+uint16_t adc_latest(uint8_t channel) {
+	for ( uint8_t i = 0; i < adc_count; i++ ) {
+		if ( adc_channels[i] == channel ) {
+			uint16_t value;
+			ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+				value = adc_values[i];
+			}
+			return value;
+		}
+	}
+	return 0;
+}
+
+/*
+**	Conversion complete: store it and select the next channel. In trigger
+**	mode the next conversion starts on the next trigger, long after the
+**	new channel is selected.
+*/
+ISR(ADC_vect) {
+	uint8_t i = adc_slot;
+	adc_store(i, ADC);
+
+	if ( ++i >= adc_count ) {
+		i = 0;
+	}
+	adc_slot = i;
+	adc_select(adc_channels[i]);
+
+	if ( adc_continuous ) {
+		ADCSRA |= (1 << ADSC);
+	}
+}
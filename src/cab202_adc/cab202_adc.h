@@ -35,3 +35,66 @@ void adc_init();
 **	4 = Broken-out Pin F4.
 */
 uint16_t adc_read(uint8_t channel);
+
+/*
+**	Background sampling.
+**
+**	adc_start() converts a list of channels in turn from ADC_vect, so the
+**	main loop can take the latest value of each with adc_latest() instead
+**	of waiting ~208 us per conversion in adc_read(). Do not call adc_read()
+**	while background sampling is running.
+**
+**	Build options. Define with -D:
+**
+**	ADC_MAX_CHANNELS - most channels adc_start() accepts (default 4).
+**	ADC_MEDIAN - 1 to take the median of the last 3 samples per channel,
+**			  which removes single-sample spikes (default 1).
+**	ADC_IIR_SHIFT - smooth each channel with a first-order IIR filter,
+**			  value += (sample - value) / 2^ADC_IIR_SHIFT; 0 disables it
+**			  (default 2, at most 6).
+*/
+#ifndef ADC_MAX_CHANNELS
+#define ADC_MAX_CHANNELS 4
+#endif
+
+#ifndef ADC_MEDIAN
+#define ADC_MEDIAN 1
+#endif
+
+#ifndef ADC_IIR_SHIFT
+#define ADC_IIR_SHIFT 2
+#endif
+
+/*
+**	What starts each conversion.
+**
+**	ADC_TRIGGER_CONTINUOUS - each conversion starts as soon as the previous
+**			  one is stored, about 4800 conversions per second in total.
+**	ADC_TRIGGER_TIMER0_OVF, ADC_TRIGGER_TIMER1_OVF - one conversion per timer
+**			  overflow (auto trigger, table 24-6 in datasheet). The timer's
+**			  overflow flag must be cleared each period, which happens
+**			  automatically if its overflow interrupt is enabled.
+*/
+#define ADC_TRIGGER_TIMER0_OVF 4
+#define ADC_TRIGGER_TIMER1_OVF 6
+#define ADC_TRIGGER_CONTINUOUS 0xFF
+
+/*
+**	Start sampling channels[0..count-1] round robin. count is limited to
+**	ADC_MAX_CHANNELS. Each channel is read once before this returns, so
+**	adc_latest() is valid immediately. Requires adc_init() and enables
+**	the ADC interrupt; global interrupts must be enabled for sampling to
+**	continue.
+*/
+void adc_start(const uint8_t *channels, uint8_t count, uint8_t trigger);
+
+/*
+**	Stop background sampling. adc_read() may be used again afterwards.
+*/
+void adc_stop();
+
+/*
+**	Latest filtered value of a channel passed to adc_start(), or 0 if it
+**	is not being sampled. Does not block.
+*/
+uint16_t adc_latest(uint8_t channel);
@@ -0,0 +1,94 @@
+/*
+ *  CAB202 Teensy Library (cab202_teensy)
+ *	debounce.h
+ *
+ *	Debounces up to eight inputs at once with vertical counters: bit n of
+ *	each counter byte is one bit of input n's counter, so every input is
+ *	counted in parallel with a few bitwise operations per sample.
+ *
+ *	An input changes state after DEBOUNCE_DEPTH consecutive samples that
+ *	differ from its current state; any agreeing sample restarts its count.
+ *	Changes are also latched as press and release edges for the main loop.
+ *
+ *	debounce_update() is meant to be called from a timer interrupt, and
+ *	the other functions from the main loop.
+ */
+#ifndef DEBOUNCE_H_
+#define DEBOUNCE_H_
+
+#include <stdint.h>
+#include <util/atomic.h>
+
+/*
+ *	Build options. Define before including, or with -D:
+ *
+ *	DEBOUNCE_BITS - counter width; DEBOUNCE_DEPTH is 2^DEBOUNCE_BITS
+ *		samples (default 2, i.e. 4 samples).
+ */
+#ifndef DEBOUNCE_BITS
+#define DEBOUNCE_BITS 2
+#endif
+
+#define DEBOUNCE_DEPTH (1 << DEBOUNCE_BITS)
+
+typedef struct debouncer_t {
+	volatile uint8_t state;
+	uint8_t count[DEBOUNCE_BITS];
+	// Edges seen since the main loop last took them.
+	volatile uint8_t pressed, released;
+} debouncer_t;
+
+/*
+ *	Feed one sample, bit n being input n (1 = active).
+ */
+static inline void debounce_update(debouncer_t *db, uint8_t sample) {
+	uint8_t delta = sample ^ db->state;
+
+	// Count up inputs that differ from their state, reset the rest.
+	uint8_t carry = delta;
+	for ( uint8_t i = 0; i < DEBOUNCE_BITS; i++ ) {
+		uint8_t next = db->count[i] & carry;
+		db->count[i] = (db->count[i] ^ carry) & delta;
+		carry = next;
+	}
+
+	// A carry out of the top bit means the count wrapped: flip the state.
+	uint8_t toggled = carry;
+	uint8_t state = db->state ^ toggled;
+	db->state = state;
+	db->pressed |= toggled & state;
+	db->released |= toggled & ~state;
+}
+
+/*
+ *	Debounced state of all inputs.
+ */
+static inline uint8_t debounce_state(const debouncer_t *db) {
+	return db->state;
+}
+
+/*
+ *	Inputs pressed since the last call. Clears them.
+ */
+static inline uint8_t debounce_take_pressed(debouncer_t *db) {
+	uint8_t edges;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		edges = db->pressed;
+		db->pressed = 0;
+	}
+	return edges;
+}
+
+/*
+ *	Inputs released since the last call. Clears them.
+ */
+static inline uint8_t debounce_take_released(debouncer_t *db) {
+	uint8_t edges;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		edges = db->released;
+		db->released = 0;
+	}
+	return edges;
+}
+
+#endif /* DEBOUNCE_H_ */
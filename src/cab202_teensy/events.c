@@ -0,0 +1,88 @@
+/*
+ *  CAB202 Teensy Library (cab202_teensy)
+ *	events.c
+ *
+ *	Timed callback queue. See events.h.
+ */
+#include "events.h"
+
+typedef struct event_t {
+	uint32_t due;
+	event_fn fn;
+} event_t;
+
+// Pending events, earliest first.
+static event_t queue[EVENT_QUEUE_SIZE];
+static uint8_t queue_len = 0;
+
+// Wrap-safe "a is before b".
+static inline uint8_t before(uint32_t a, uint32_t b) {
+	return (int32_t)(a - b) < 0;
+}
+
+static void remove_at(uint8_t i) {
+	queue_len--;
+	for ( ; i < queue_len; i++ ) {
+		queue[i] = queue[i + 1];
+	}
+}
+
+static int8_t find(event_fn fn) {
+	for ( uint8_t i = 0; i < queue_len; i++ ) {
+		if ( queue[i].fn == fn ) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+void events_clear(void) {
+	queue_len = 0;
+}
+
+uint8_t event_schedule(event_fn fn, uint32_t due) {
+	event_cancel(fn);
+
+	if ( queue_len >= EVENT_QUEUE_SIZE ) {
+		return 0;
+	}
+
+	// Insertion sort; equal times run in the order they were scheduled.
+	uint8_t i = queue_len;
+	while ( i > 0 && before(due, queue[i - 1].due) ) {
+		queue[i] = queue[i - 1];
+		i--;
+	}
+	queue[i].due = due;
+	queue[i].fn = fn;
+	queue_len++;
+	return 1;
+}
+
+void event_cancel(event_fn fn) {
+	int8_t i = find(fn);
+	if ( i >= 0 ) {
+		remove_at(i);
+	}
+}
+
+uint8_t event_pending(event_fn fn) {
+	return find(fn) >= 0;
+}
+
+uint8_t event_due(event_fn fn, uint32_t *due) {
+	int8_t i = find(fn);
+	if ( i < 0 ) {
+		return 0;
+	}
+	*due = queue[i].due;
+	return 1;
+}
+
+void events_run(uint32_t now) {
+	while ( queue_len > 0 && !before(now, queue[0].due) ) {
+		event_fn fn = queue[0].fn;
+		remove_at(0);
+		fn();
+	}
+}
@@ -0,0 +1,67 @@
+/*
+ *  CAB202 Teensy Library (cab202_teensy)
+ *	events.h
+ *
+ *	A small queue of timed callbacks, kept sorted by due time so that
+ *	checking for due events costs one comparison when nothing is due.
+ *	Times are in whatever unit the caller passes to event_schedule() and
+ *	events_run(), typically milliseconds, and may wrap: events must be
+ *	scheduled less than 2^31 units ahead.
+ *
+ *	The queue is driven from the main loop, not from interrupts. Pausing
+ *	is handled by the caller passing a clock that stops while paused.
+ */
+#ifndef EVENTS_H_
+#define EVENTS_H_
+
+#include <stdint.h>
+
+/*
+ *	Build options. Define before including, or with -D:
+ *
+ *	EVENT_QUEUE_SIZE - maximum number of pending events (default 8).
+ */
+#ifndef EVENT_QUEUE_SIZE
+#define EVENT_QUEUE_SIZE 8
+#endif
+
+/*
+ *	Event callback. Each callback is one event: scheduling a callback that
+ *	is already pending moves it rather than adding a second entry.
+ *	Callbacks may schedule or cancel events, including themselves.
+ */
+typedef void (*event_fn)(void);
+
+/*
+ *	Remove all pending events.
+ */
+void events_clear(void);
+
+/*
+ *	Schedule fn to run when the clock reaches due, replacing any pending
+ *	entry for fn. Returns 0 if the queue is full.
+ */
+uint8_t event_schedule(event_fn fn, uint32_t due);
+
+/*
+ *	Remove the pending entry for fn, if any.
+ */
+void event_cancel(event_fn fn);
+
+/*
+ *	Return non-zero if fn is pending.
+ */
+uint8_t event_pending(event_fn fn);
+
+/*
+ *	If fn is pending, store its due time in *due and return non-zero.
+ */
+uint8_t event_due(event_fn fn, uint32_t *due);
+
+/*
+ *	Run, earliest first, every event due at or before now. Events that
+ *	callbacks schedule for now or earlier also run before this returns.
+ */
+void events_run(uint32_t now);
+
+#endif /* EVENTS_H_ */
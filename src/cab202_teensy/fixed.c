@@ -0,0 +1,101 @@
+/*
+ *  CAB202 Teensy Library (cab202_teensy)
+ *	fixed.c
+ *
+ *	Table-driven trigonometry and integer square roots for fixed_t.
+ *	See fixed.h.
+ */
+#include <avr/pgmspace.h>
+
+#include "fixed.h"
+
+/*
+ *	sin(i * 90 / 64 degrees) * FIX_ONE, rounded, for i = 0..64.
+ */
+static const uint16_t sin_table[65] PROGMEM = {
+	0, 6, 13, 19, 25, 31, 38, 44, 50, 56, 62, 68, 74, 80, 86, 92,
+	98, 104, 109, 115, 121, 126, 132, 137, 142, 147, 152, 157, 162, 167, 172, 177,
+	181, 185, 190, 194, 198, 202, 206, 209, 213, 216, 220, 223, 226, 229, 231, 234,
+	237, 239, 241, 243, 245, 247, 248, 250, 251, 252, 253, 254, 255, 255, 256, 256,
+	256
+};
+
+fixed_t fix_sin(angle_t a) {
+	uint8_t i = a & 63;
+
+	// Second and fourth quadrants run the table backwards.
+	if ( a & 64 ) {
+		i = 64 - i;
+	}
+
+	fixed_t value = pgm_read_word(&sin_table[i]);
+
+	// Lower half of the circle is negative.
+	return (a & 128) ? -value : value;
+}
+
+fixed_t fix_cos(angle_t a) {
+	return fix_sin(a + ANGLE_TURN / 4);
+}
+
+/*
+ *	Integer square root: largest r with r * r <= n. One result bit per
+ *	iteration, shifts and subtracts only.
+ */
+static uint16_t isqrt32(uint32_t n) {
+	uint32_t root = 0;
+	uint32_t bit = (uint32_t)1 << 30;
+
+	while ( bit > n ) {
+		bit >>= 2;
+	}
+
+	while ( bit != 0 ) {
+		if ( n >= root + bit ) {
+			n -= root + bit;
+			root = (root >> 1) + bit;
+		}
+		else {
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+
+	return root;
+}
+
+fixed_t fix_sqrt(fixed_t a) {
+	// sqrt(a / 2^8) * 2^8 == sqrt(a * 2^8)
+	return isqrt32((uint32_t)a << FIX_SHIFT);
+}
+
+uint8_t fix_normalize(fixed_t *x, fixed_t *y) {
+	uint32_t ax = *x < 0 ? -*x : *x;
+	uint32_t ay = *y < 0 ? -*y : *y;
+
+	if ( (ax | ay) == 0 ) {
+		return 0;
+	}
+
+	// Scale short vectors up, which leaves the direction alone, so that
+	// the length has 15 significant bits however short the vector is.
+	// Squaring fixed_t values instead would lose everything below 1/16.
+	while ( (ax | ay) < ((uint32_t)1 << 14) ) {
+		ax <<= 1;
+		ay <<= 1;
+	}
+
+	// Both components are below 2^15, so the exact squares fit.
+	uint32_t length = isqrt32(ax * ax + ay * ay);
+
+	// Reciprocal of the length scaled by 2^30. No component is longer
+	// than the vector, so component * inverse is at most 2^30: the
+	// quotient with 22 fractional bits, rounded to the 8 of a fixed_t.
+	uint32_t inverse = ((uint32_t)1 << 30) / length;
+	fixed_t nx = (ax * inverse + ((uint32_t)1 << 21)) >> 22;
+	fixed_t ny = (ay * inverse + ((uint32_t)1 << 21)) >> 22;
+
+	*x = *x < 0 ? -nx : nx;
+	*y = *y < 0 ? -ny : ny;
+	return 1;
+}
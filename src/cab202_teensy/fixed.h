@@ -0,0 +1,103 @@
+/*
+ *  CAB202 Teensy Library (cab202_teensy)
+ *	fixed.h
+ *
+ *	Signed fixed-point arithmetic, for when float is too slow. The AVR has
+ *	no FPU, so every float operation is a library call of a few hundred
+ *	cycles; these are a handful of integer instructions each.
+ *
+ *	A fixed_t holds value * 2^FIX_SHIFT. There are 8 fractional bits
+ *	(resolution 1/256), as in Q8.8, but the integer part is 23 bits wide so
+ *	that off-screen coordinates do not overflow. Products and quotients
+ *	have a narrower range, because they are formed in 32 bits before
+ *	scaling: see fix_mul() and fix_div().
+ */
+#ifndef FIXED_H_
+#define FIXED_H_
+
+#include <stdint.h>
+
+typedef int32_t fixed_t;
+
+#define FIX_SHIFT	8
+#define FIX_ONE		((fixed_t)1 << FIX_SHIFT)
+#define FIX_HALF	(FIX_ONE >> 1)
+
+/*
+ *	Conversions. FIX() takes any arithmetic value (truncating toward zero)
+ *	and folds to a constant when given a constant; FIX_INT() is exact for
+ *	integers. FIX_TO_DOUBLE() is for debugging output.
+ */
+#define FIX(x)				((fixed_t)((x) * FIX_ONE))
+#define FIX_INT(n)			((fixed_t)(n) * FIX_ONE)
+#define FIX_TO_DOUBLE(a)	((double)(a) / FIX_ONE)
+
+/*
+ *	Product of two fixed_t. The raw product carries 16 fractional bits
+ *	and must fit in 31 bits before scaling, so |a * b| < 2^15 (32768.0) in
+ *	real terms: a screen coordinate (< 128) times a speed (< 256) is fine,
+ *	the square of anything over 181 is not.
+ */
+static inline fixed_t fix_mul(fixed_t a, fixed_t b) {
+	return (a * b) >> FIX_SHIFT;
+}
+
+/*
+ *	Quotient of two fixed_t, truncated toward zero. b must be non-zero and
+ *	|a| < 2^15 (32768.0), as a is scaled up by FIX_ONE first.
+ */
+static inline fixed_t fix_div(fixed_t a, fixed_t b) {
+	return (a * FIX_ONE) / b;
+}
+
+/*
+ *	Largest integer not greater than a.
+ */
+static inline int fix_floor(fixed_t a) {
+	return a >> FIX_SHIFT;
+}
+
+/*
+ *	Integer part of a, rounded toward zero (like a cast from double).
+ */
+static inline int fix_trunc(fixed_t a) {
+	return a < 0 ? -(-a >> FIX_SHIFT) : a >> FIX_SHIFT;
+}
+
+/*
+ *	Nearest integer to a, halves rounded away from zero (like round()).
+ */
+static inline int fix_round(fixed_t a) {
+	return a < 0 ? -((-a + FIX_HALF) >> FIX_SHIFT) : (a + FIX_HALF) >> FIX_SHIFT;
+}
+
+/*
+ *	Binary angle: a full turn is ANGLE_TURN units, so angles wrap for free
+ *	in 8-bit arithmetic. ANGLE_TURN / 4 is a right angle.
+ */
+typedef uint8_t angle_t;
+
+#define ANGLE_TURN	256
+
+/*
+ *	Sine and cosine of a binary angle, from a quarter-wave table in flash.
+ *	Results are exact to within 1/512.
+ */
+fixed_t fix_sin(angle_t a);
+fixed_t fix_cos(angle_t a);
+
+/*
+ *	Square root of a non-negative fixed_t (a < 2^23, i.e. 32768.0).
+ */
+fixed_t fix_sqrt(fixed_t a);
+
+/*
+ *	Scale the vector (*x, *y) to unit length using one integer square
+ *	root and one divide. Each component is rounded, so is within 1/512
+ *	(plus 1/2^14 of the length) of exact, however short the vector. The
+ *	vector must be shorter than 128.0 for its squared length to fit.
+ *	Returns 0, leaving the vector alone, if it has zero length.
+ */
+uint8_t fix_normalize(fixed_t *x, fixed_t *y);
+
+#endif /* FIXED_H_ */
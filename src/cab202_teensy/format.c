@@ -0,0 +1,67 @@
+/*
+ *  CAB202 Teensy Library (cab202_teensy)
+ *	format.c
+ *
+ *	Integer-only text formatting. See format.h.
+ */
+#include <avr/pgmspace.h>
+
+#include "format.h"
+
+char *fmt_str(char *p, char *end, const char *s) {
+	while ( *s && p < end - 1 ) {
+		*p++ = *s++;
+	}
+	*p = 0;
+	return p;
+}
+
+char *fmt_str_P(char *p, char *end, const char *s) {
+	char c;
+	while ( p < end - 1 && (c = pgm_read_byte(s++)) ) {
+		*p++ = c;
+	}
+	*p = 0;
+	return p;
+}
+
+char *fmt_uint(char *p, char *end, uint32_t value, uint8_t width) {
+	char digits[FMT_UINT_DIGITS];
+	uint8_t n = 0;
+
+	// 32-bit division is several times slower on the AVR, so switch to
+	// 16 bits as soon as the value fits.
+	while ( value > 0xFFFF ) {
+		digits[n++] = '0' + value % 10;
+		value /= 10;
+	}
+	uint16_t small = value;
+	do {
+		digits[n++] = '0' + small % 10;
+		small /= 10;
+	} while ( small );
+
+	while ( width > n && p < end - 1 ) {
+		*p++ = '0';
+		width--;
+	}
+	while ( n && p < end - 1 ) {
+		*p++ = digits[--n];
+	}
+	*p = 0;
+	return p;
+}
+
+char *fmt_int(char *p, char *end, int32_t value) {
+	if ( value < 0 ) {
+		p = fmt_str(p, end, "-");
+		return fmt_uint(p, end, -(uint32_t)value, 0);
+	}
+	return fmt_uint(p, end, value, 0);
+}
+
+char *fmt_mmss(char *p, char *end, uint32_t seconds) {
+	p = fmt_uint(p, end, seconds / 60, 2);
+	p = fmt_str(p, end, ":");
+	return fmt_uint(p, end, seconds % 60, 2);
+}
@@ -0,0 +1,58 @@
+/*
+ *  CAB202 Teensy Library (cab202_teensy)
+ *	format.h
+ *
+ *	Integer-only text formatting, as a small replacement for sprintf()
+ *	that does not pull in the printf machinery.
+ *
+ *	Each function writes at p, never at or past end (one past the last
+ *	byte of the buffer), NUL-terminates, and returns a pointer to the
+ *	terminator so calls can be chained:
+ *		char buf[12];
+ *		char *p = fmt_int(fmt_str(buf, FMT_END(buf), "S:"), FMT_END(buf), score);
+ *
+ *	Text that does not fit is cut off, so size buffers for the longest
+ *	output: FMT_UINT_DIGITS characters for any 32-bit number (one more
+ *	for a sign), 5 for mm:ss, and 1 for the NUL. p must be below end.
+ */
+#ifndef FORMAT_H_
+#define FORMAT_H_
+
+#include <stdint.h>
+
+/*
+ *	End of an array buffer, for the end argument.
+ */
+#define FMT_END(buffer)	((buffer) + sizeof(buffer))
+
+/*
+ *	Most digits in a 32-bit unsigned number.
+ */
+#define FMT_UINT_DIGITS	10
+
+/*
+ *	Copy a string held in RAM.
+ */
+char *fmt_str(char *p, char *end, const char *s);
+
+/*
+ *	Copy a string held in flash, e.g. PSTR("Score: ").
+ */
+char *fmt_str_P(char *p, char *end, const char *s);
+
+/*
+ *	Unsigned decimal, zero-padded to at least width digits.
+ */
+char *fmt_uint(char *p, char *end, uint32_t value, uint8_t width);
+
+/*
+ *	Signed decimal, with a leading '-' if negative.
+ */
+char *fmt_int(char *p, char *end, int32_t value);
+
+/*
+ *	Minutes and seconds as mm:ss. Minutes keep counting past 99.
+ */
+char *fmt_mmss(char *p, char *end, uint32_t seconds);
+
+#endif /* FORMAT_H_ */
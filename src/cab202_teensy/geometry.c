@@ -0,0 +1,41 @@
+/*
+ *  CAB202 Teensy Library (cab202_teensy)
+ *	geometry.c
+ *
+ *	Segment versus box intersection. See geometry.h.
+ */
+#include "geometry.h"
+
+void segment_bounds(fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2, box_t *bounds) {
+	bounds->x0 = x1 < x2 ? x1 : x2;
+	bounds->x1 = x1 < x2 ? x2 : x1;
+	bounds->y0 = y1 < y2 ? y1 : y2;
+	bounds->y1 = y1 < y2 ? y2 : y1;
+}
+
+/*
+ *	Which side of the line through (x1, y1) with direction (dx, dy) the
+ *	point (px, py) is on: positive, negative, or zero if on the line.
+ */
+static inline int8_t side(fixed_t x1, fixed_t y1, fixed_t dx, fixed_t dy, fixed_t px, fixed_t py) {
+	int32_t cross = dx * (py - y1) - dy * (px - x1);
+	return (cross > 0) - (cross < 0);
+}
+
+uint8_t segment_hits_box(fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2, const box_t *bounds, const box_t *box) {
+	// Separating axis test: the boxes' x and y axes first...
+	if ( !boxes_overlap(bounds, box) ) {
+		return 0;
+	}
+
+	// ...then the segment's normal: every corner strictly on one side
+	// of the line means no contact.
+	fixed_t dx = x2 - x1;
+	fixed_t dy = y2 - y1;
+	int8_t s = side(x1, y1, dx, dy, box->x0, box->y0)
+		+ side(x1, y1, dx, dy, box->x1, box->y0)
+		+ side(x1, y1, dx, dy, box->x0, box->y1)
+		+ side(x1, y1, dx, dy, box->x1, box->y1);
+
+	return s != 4 && s != -4;
+}
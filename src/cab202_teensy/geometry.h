@@ -0,0 +1,46 @@
+/*
+ *  CAB202 Teensy Library (cab202_teensy)
+ *	geometry.h
+ *
+ *	Exact intersection tests between line segments and axis-aligned boxes,
+ *	in fixed point (see fixed.h). Unlike testing pixels in a rendered
+ *	buffer, these work at sub-pixel positions and do not depend on what
+ *	has been drawn.
+ */
+#ifndef GEOMETRY_H_
+#define GEOMETRY_H_
+
+#include <stdint.h>
+
+#include "fixed.h"
+
+/*
+ *	Closed axis-aligned box: all points with x0 <= x <= x1, y0 <= y <= y1.
+ */
+typedef struct box_t {
+	fixed_t x0, y0, x1, y1;
+} box_t;
+
+/*
+ *	Return non-zero if two boxes share at least one point.
+ */
+static inline uint8_t boxes_overlap(const box_t *a, const box_t *b) {
+	return a->x0 <= b->x1 && b->x0 <= a->x1 && a->y0 <= b->y1 && b->y0 <= a->y1;
+}
+
+/*
+ *	Bounding box of the segment (x1, y1)-(x2, y2).
+ */
+void segment_bounds(fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2, box_t *bounds);
+
+/*
+ *	Return non-zero if the segment (x1, y1)-(x2, y2) touches box.
+ *
+ *	bounds must be the segment's bounding box (from segment_bounds()), so
+ *	that callers testing one segment against many boxes compute it once.
+ *	Segments and boxes must be less than 128.0 across, and no further apart
+ *	than that, for the cross products to fit in 32 bits.
+ */
+uint8_t segment_hits_box(fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2, const box_t *bounds, const box_t *box);
+
+#endif /* GEOMETRY_H_ */
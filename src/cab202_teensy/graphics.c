@@ -8,9 +8,14 @@
 **
 **	Revisions:
 **	2017-10-11 - Changed screen coordinates to int from uint8_t. LB.
+**	Dirty column tracking per bank, so show_screen() only sends changes.
+**	Optional front buffer, so drawing overlaps with sending to the LCD.
+**	draw_char() writes whole column bytes instead of single pixels.
+**	Integer-only draw_line(), with byte-wise horizontal/vertical fills.
 */
 #include <avr/pgmspace.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "graphics.h"
 #include "macros.h"
@@ -21,29 +26,147 @@
  */
 uint8_t screen_buffer[LCD_BUFFER_SIZE];
 
+#if GRAPHICS_DIRTY_TRACKING
+/*
+ *	Column span [dirty_lo, dirty_hi] of each bank that has changed since
+ *	the last show_screen(). A clean bank has dirty_lo > dirty_hi. Everything
+ *	starts dirty because the contents of the LCD RAM are unknown.
+ */
+static uint8_t dirty_lo[LCD_BANKS] = { 0, 0, 0, 0, 0, 0 };
+static uint8_t dirty_hi[LCD_BANKS] = { LCD_X - 1, LCD_X - 1, LCD_X - 1, LCD_X - 1, LCD_X - 1, LCD_X - 1 };
+
+/*
+ *	Widen the dirty span of a bank to include column x.
+ */
+static inline void mark_dirty(uint8_t bank, uint8_t x) {
+	if ( x < dirty_lo[bank] ) dirty_lo[bank] = x;
+	if ( x > dirty_hi[bank] ) dirty_hi[bank] = x;
+}
+#endif
+
+#if GRAPHICS_DOUBLE_BUFFER
+/*
+ *	Completed frame that the LCD transport reads from while the next frame
+ *	is drawn into screen_buffer.
+ */
+static uint8_t front_buffer[LCD_BUFFER_SIZE];
+#define FLUSH_BUFFER front_buffer
+#else
+#define FLUSH_BUFFER screen_buffer
+#endif
+
+/*
+ *	Copy len bytes at offset from screen_buffer to the front buffer (when
+ *	double buffered) and queue them for the LCD.
+ */
+static void flush_span(uint16_t offset, uint8_t len) {
+#if GRAPHICS_DOUBLE_BUFFER
+	memcpy(&front_buffer[offset], &screen_buffer[offset], len);
+#endif
+	lcd_write_data(&FLUSH_BUFFER[offset], len);
+}
+
+/*
+ *	Publish the frame in screen_buffer and start sending it to the LCD.
+ *	(sends the changed column span of each bank, or the entire buffer
+ *	when GRAPHICS_DIRTY_TRACKING is 0)
+ */
+void swap_and_flush(void) {
+#if GRAPHICS_DOUBLE_BUFFER
+	// The previous frame may still be on its way out of front_buffer.
+	lcd_sync();
+#endif
+
+#if GRAPHICS_DIRTY_TRACKING
+	for ( uint8_t bank = 0; bank < LCD_BANKS; bank++ ) {
+		if ( dirty_lo[bank] > dirty_hi[bank] ) {
+			continue;
+		}
+
+		// Move to the first changed column, then stream the span. The LCD
+		// auto-increments its column address after every data byte.
+		lcd_position(dirty_lo[bank], bank);
+		flush_span(bank * LCD_X + dirty_lo[bank], dirty_hi[bank] - dirty_lo[bank] + 1);
+
+		dirty_lo[bank] = 0xFF;
+		dirty_hi[bank] = 0;
+	}
+#else
+	// Reset our position in the LCD RAM
+	lcd_position(0, 0);
+
+	// Send our buffer to the LCD, one bank at a time.
+	for ( int i = 0; i < LCD_BUFFER_SIZE; i += LCD_X ) {
+		flush_span(i, LCD_X);
+	}
+#endif
+}
+
 /*
  *  Copy the contents of the screen buffer to the LCD.
  *	This is the only function that interfaces with the LCD hardware
- *  (sends entire current buffer to LCD screen)
+ *	(same as swap_and_flush())
  */
 void show_screen(void) {
-	// Reset our position in the LCD RAM
-	lcd_position(0, 0);
+	swap_and_flush();
+}
 
-	// Iterate through our buffer and write each byte to the LCD.
-	for ( int i = 0; i < LCD_BUFFER_SIZE; i++ ) {
-		lcd_write(LCD_D, screen_buffer[i]);
+/*
+ *	Mark the whole screen buffer as changed, so that the next call to
+ *	show_screen() sends every byte.
+ */
+void invalidate_screen(void) {
+#if GRAPHICS_DIRTY_TRACKING
+	for ( uint8_t bank = 0; bank < LCD_BANKS; bank++ ) {
+		dirty_lo[bank] = 0;
+		dirty_hi[bank] = LCD_X - 1;
 	}
+#endif
 }
 
 /*
  * Clear the screen buffer (all pixels set to BG_COLOUR).
  */
 void clear_screen(void) {
+#if !GRAPHICS_DOUBLE_BUFFER
+	// A queued LCD transport may still be reading the previous frame.
+	lcd_sync();
+#endif
+
+#if GRAPHICS_DIRTY_TRACKING
+	// Only bytes that were lit need to be resent.
+	uint8_t *p = screen_buffer;
+	for ( uint8_t bank = 0; bank < LCD_BANKS; bank++ ) {
+		for ( uint8_t x = 0; x < LCD_X; x++, p++ ) {
+			if ( *p ) {
+				*p = 0;
+				mark_dirty(bank, x);
+			}
+		}
+	}
+#else
 	// Set every byte in the buffer to 0b00000000
 	for ( int i = 0; i < LCD_BUFFER_SIZE; i++ ) {
 		screen_buffer[i] = 0;
 	}
+#endif
+}
+
+/*
+ *	Replace the bits selected by mask in byte (bank, x) of screen_buffer
+ *	with the corresponding bits of value. No bounds checks.
+ */
+static inline void write_byte_masked(uint8_t bank, uint8_t x, uint8_t mask, uint8_t value) {
+	uint8_t *p = &screen_buffer[bank * LCD_X + x];
+	uint8_t old = *p;
+
+	*p = (old & ~mask) | (value & mask);
+
+#if GRAPHICS_DIRTY_TRACKING
+	if ( *p != old ) {
+		mark_dirty(bank, x);
+	}
+#endif
 }
 
 /**
@@ -67,13 +190,49 @@ void draw_pixel(int x, int y, colour_t colour) {
 	uint8_t pixel = y & 7;
 
 	// Set that particular pixel in our screen buffer
+	uint8_t *p = &screen_buffer[bank*LCD_X + x];
+	uint8_t old = *p;
+
 	if ( colour ) {
 		// Draw Pixel
-		screen_buffer[bank*LCD_X + x] |= (1 << pixel);
+		*p = old | (1 << pixel);
 	}
 	else {
 		// Erase Pixel
-		screen_buffer[bank*LCD_X + x] &= ~(1 << pixel);
+		*p = old & ~(1 << pixel);
+	}
+
+#if GRAPHICS_DIRTY_TRACKING
+	if ( *p != old ) {
+		mark_dirty(bank, x);
+	}
+#endif
+}
+
+/**
+ *	Draw (or erase) up to 8 vertically adjacent pixels in the screen buffer.
+ *
+ *	Parameters:
+ *		x - The horizontal position of the column.
+ *		y - The vertical position of the top pixel. Bit i of bits and mask
+ *			refers to the pixel at (x, y + i).
+ *		bits - The colour of each pixel: 1 for FG_COLOUR, 0 for BG_COLOUR.
+ *		mask - Only pixels whose bit is set in mask are changed.
+ */
+void draw_column(int x, int y, uint8_t bits, uint8_t mask) {
+	if ( x < 0 || x >= LCD_X || y <= -8 || y >= LCD_Y ) {
+		return;
+	}
+
+	int bank = y >> 3;
+	uint8_t shift = y & 7;
+
+	if ( bank >= 0 ) {
+		write_byte_masked(bank, x, mask << shift, bits << shift);
+	}
+
+	if ( shift != 0 && bank + 1 < LCD_BANKS ) {
+		write_byte_masked(bank + 1, x, mask >> (8 - shift), bits >> (8 - shift));
 	}
 }
 
@@ -89,15 +248,41 @@ void draw_pixel(int x, int y, colour_t colour) {
  */
 void draw_line(int x1, int y1, int x2, int y2, colour_t colour) {
 	if ( x1 == x2 ) {
-		// Draw vertical line
-		for ( int i = y1; (y2 > y1) ? i <= y2 : i >= y2; (y2 > y1) ? i++ : i-- ) {
-			draw_pixel(x1, i, colour);
+		// Draw vertical line, one masked byte per bank
+		if ( x1 < 0 || x1 >= LCD_X ) {
+			return;
+		}
+
+		int lo = y1 < y2 ? y1 : y2;
+		int hi = y1 < y2 ? y2 : y1;
+		if ( lo < 0 ) lo = 0;
+		if ( hi >= LCD_Y ) hi = LCD_Y - 1;
+
+		for ( int bank = lo >> 3; lo <= hi; bank++ ) {
+			int bank_end = (bank << 3) + 7;
+			int end = hi < bank_end ? hi : bank_end;
+			uint8_t mask = (0xFF << (lo & 7)) & (0xFF >> (7 - (end & 7)));
+
+			write_byte_masked(bank, x1, mask, colour ? 0xFF : 0);
+			lo = end + 1;
 		}
 	}
 	else if ( y1 == y2 ) {
-		// Draw horizontal line
-		for ( int i = x1; (x2 > x1) ? i <= x2 : i >= x2; (x2 > x1) ? i++ : i-- ) {
-			draw_pixel(i, y1, colour);
+		// Draw horizontal line, one bit per column of a single bank
+		if ( y1 < 0 || y1 >= LCD_Y ) {
+			return;
+		}
+
+		int lo = x1 < x2 ? x1 : x2;
+		int hi = x1 < x2 ? x2 : x1;
+		if ( lo < 0 ) lo = 0;
+		if ( hi >= LCD_X ) hi = LCD_X - 1;
+
+		uint8_t bank = y1 >> 3;
+		uint8_t mask = 1 << (y1 & 7);
+
+		for ( int x = lo; x <= hi; x++ ) {
+			write_byte_masked(bank, x, mask, colour ? 0xFF : 0);
 		}
 	}
 	else {
@@ -112,19 +297,22 @@ void draw_line(int x1, int y1, int x2, int y2, colour_t colour) {
 			y2 = t;
 		}
 
-		// Get Bresenhaming...
-		float dx = x2 - x1;
-		float dy = y2 - y1;
-		float err = 0.0;
-		float derr = ABS(dy / dx);
+		// Get Bresenhaming... The error term is kept scaled by 2*dx so that
+		// it stays integral: a step of |dy|/dx becomes 2*|dy|, the 0.5
+		// threshold becomes dx and 1.0 becomes 2*dx.
+		int dx = x2 - x1;
+		int dy = y2 - y1;
+		int step_y = SIGN(dy);
+		int derr = 2 * ABS(dy);
+		int err = 0;
 
-		for ( int x = x1, y = y1; (dx > 0) ? x <= x2 : x >= x2; (dx > 0) ? x++ : x-- ) {
+		for ( int x = x1, y = y1; x <= x2; x++ ) {
 			draw_pixel(x, y, colour);
 			err += derr;
-			while ( err >= 0.5 && ((dy > 0) ? y <= y2 : y >= y2) ) {
+			while ( err >= dx && ((dy > 0) ? y <= y2 : y >= y2) ) {
 				draw_pixel(x, y, colour);
-				y += (dy > 0) - (dy < 0);
-				err -= 1.0;
+				y += step_y;
+				err -= 2 * dx;
 			}
 		}
 	}
@@ -140,17 +328,38 @@ void draw_line(int x1, int y1, int x2, int y2, colour_t colour) {
  *			range from 0x20 == 32 to 0x7f == 127.
  */
 void draw_char(int top_left_x, int top_left_y, char character, colour_t colour) {
-	// loop through each pixel in the character array and plot each one individually
-	// TODO: This can be done more efficiently by careful bit-masking.
-	for ( uint8_t i = 0; i < CHAR_WIDTH; i++ ) {
-		uint8_t pixel_data = pgm_read_byte(&(ASCII[character - 0x20][i]));
+	// Clip once for the whole glyph: columns [x0, x1) are on screen.
+	int x0 = top_left_x < 0 ? 0 : top_left_x;
+	int x1 = top_left_x + CHAR_WIDTH > LCD_X ? LCD_X : top_left_x + CHAR_WIDTH;
+
+	if ( x0 >= x1 || top_left_y <= -CHAR_HEIGHT || top_left_y >= LCD_Y ) {
+		return;
+	}
+
+	// The glyph covers the bottom of bank 'bank' and, unless it is 8-aligned,
+	// the top of the bank below. Either bank may be off screen.
+	int bank = top_left_y >> 3;
+	uint8_t shift = top_left_y & 7;
+	uint8_t upper_ok = bank >= 0;
+	uint8_t lower_ok = shift != 0 && bank + 1 < LCD_BANKS;
+	uint8_t upper_mask = 0xFF << shift;
+	uint8_t lower_mask = ~upper_mask;
+
+	const uint8_t *glyph = &ASCII[character - 0x20][x0 - top_left_x];
+
+	for ( uint8_t x = x0; x < x1; x++ ) {
+		uint8_t pixel_data = pgm_read_byte(glyph++);
 
 		if ( colour == BG_COLOUR ) {
 			pixel_data = ~pixel_data;
 		}
 
-		for ( uint8_t j = 0; j < CHAR_HEIGHT; j++ ) {
-			draw_pixel(top_left_x + i, top_left_y + j, (pixel_data & (1 << j)) >> j);
+		if ( upper_ok ) {
+			write_byte_masked(bank, x, upper_mask, pixel_data << shift);
+		}
+
+		if ( lower_ok ) {
+			write_byte_masked(bank + 1, x, lower_mask, pixel_data >> (8 - shift));
 		}
 	}
 }
@@ -13,6 +13,7 @@
 
 #include "ascii_font.h"
 #include "lcd.h"
+#include "lcd_transport.h"
 
 /*
  *  Size of the screen_buffer, measured in bytes. There are LCD_X
@@ -21,6 +22,37 @@
  */
 #define LCD_BUFFER_SIZE (LCD_X * (LCD_Y / 8))
 
+/*
+ *	Number of 8-pixel-high banks (rows of bytes) in the screen_buffer.
+ */
+#define LCD_BANKS (LCD_Y / 8)
+
+/*
+ *	When GRAPHICS_DIRTY_TRACKING is non-zero, the drawing functions record
+ *	which columns of each bank have changed since the last call to
+ *	show_screen(), and show_screen() only sends those column spans to the
+ *	LCD. Define it as 0 before building the library to always send the
+ *	whole buffer.
+ */
+#ifndef GRAPHICS_DIRTY_TRACKING
+#define GRAPHICS_DIRTY_TRACKING 1
+#endif
+
+/*
+ *	When GRAPHICS_DOUBLE_BUFFER is non-zero, swap_and_flush() copies the
+ *	changed parts of screen_buffer into a private front buffer and sends
+ *	the LCD from there, so the next frame can be drawn into screen_buffer
+ *	while a queued LCD transport (see lcd_transport.h) is still sending.
+ *	Costs another LCD_BUFFER_SIZE bytes of RAM, so by default it is only
+ *	turned on for transports that actually run in the background. That is
+ *	only LCD_TRANSPORT_SPI, which needs a rewired board (lcd_transport.h),
+ *	so on a stock board the overlap cannot be tested; forcing this on
+ *	with the blocking transport checks the copying but not the overlap.
+ */
+#ifndef GRAPHICS_DOUBLE_BUFFER
+#define GRAPHICS_DOUBLE_BUFFER (LCD_TRANSPORT == LCD_TRANSPORT_SPI)
+#endif
+
 /**
  *	Enumerated type to define colours. We have two colours:
  *	FG_COLOUR - foreground.
@@ -37,13 +69,31 @@ typedef enum colour_t {
  */
 extern uint8_t screen_buffer[LCD_BUFFER_SIZE];
 
+/*
+ *	Publish the frame drawn in screen_buffer and start sending it to the
+ *	LCD (the changed column span of each bank, or the entire buffer when
+ *	GRAPHICS_DIRTY_TRACKING is 0). With GRAPHICS_DOUBLE_BUFFER and a queued
+ *	LCD transport this returns while the frame is still being sent, and
+ *	screen_buffer may be redrawn straight away. screen_buffer keeps its
+ *	contents either way.
+ */
+void swap_and_flush(void);
+
 /*
  *  Copy the contents of the screen buffer to the LCD.
  *	This is the only function that interfaces with the LCD hardware
- *  (sends entire current buffer to LCD screen)
+ *	(same as swap_and_flush())
  */
 void show_screen(void);
 
+/*
+ *	Mark the whole screen buffer as changed, so that the next call to
+ *	show_screen() sends every byte. Call this after anything other than
+ *	show_screen() has written to the LCD (e.g. lcd_clear()), or after
+ *	writing to screen_buffer directly.
+ */
+void invalidate_screen(void);
+
 /*
  * Clear the screen buffer (all pixels set to BG_COLOUR).
  */
@@ -61,6 +111,19 @@ void clear_screen(void);
  */
 void draw_pixel(int x, int y, colour_t colour);
 
+/**
+ *	Draw (or erase) up to 8 vertically adjacent pixels in the screen buffer.
+ *
+ *	Parameters:
+ *		x - The horizontal position of the column.
+ *		y - The vertical position of the top pixel. Bit i of bits and mask
+ *			refers to the pixel at (x, y + i).
+ *		bits - The colour of each pixel: 1 for FG_COLOUR, 0 for BG_COLOUR.
+ *		mask - Only pixels whose bit is set in mask are changed.
+ *			(mask == bits gives a transparent background)
+ */
+void draw_column(int x, int y, uint8_t bits, uint8_t mask);
+
 /**
  *	Draw a line in the screen buffer.
  *
@@ -10,6 +10,7 @@
 #include <util/delay.h>
 
 #include "lcd.h"
+#include "lcd_transport.h"
 #include "ascii_font.h"
 #include "macros.h"
 
@@ -21,8 +22,7 @@ void lcd_init(uint8_t contrast) {
 	SET_OUTPUT(DDRD, SCEPIN);
 	SET_OUTPUT(DDRB, RSTPIN);
 	SET_OUTPUT(DDRB, DCPIN);
-	SET_OUTPUT(DDRB, DINPIN);
-	SET_OUTPUT(DDRF, SCKPIN);
+	lcd_transport_init();
 
 	CLEAR_BIT(PORTB, RSTPIN);
 	SET_BIT(PORTD, SCEPIN);
@@ -42,25 +42,15 @@ void lcd_init(uint8_t contrast) {
 }
 
 void lcd_write(uint8_t dc, uint8_t data) {
-	// Set the DC pin based on the parameter 'dc' (Hint: use the WRITE_BIT macro)
-	WRITE_BIT(PORTB,DCPIN,dc);
-
-	// Pull the SCE/SS pin low to signal the LCD we have data
-	CLEAR_BIT(PORTD,SCEPIN);
+	lcd_transport_write(dc, data);
+}
 
-	// Write the byte of data using "bit bashing"
-	for(int i = 7; i >= 0; i--) {
-		CLEAR_BIT(PORTF, SCKPIN) ;
-		if((data>>i) & (1 == 1)) {
-			SET_BIT(PORTB, DINPIN);
-		} else {
-			CLEAR_BIT(PORTB, DINPIN);
-		}
-		SET_BIT(PORTF, SCKPIN);
-	}
+void lcd_write_data(const uint8_t *data, uint8_t len) {
+	lcd_transport_write_data(data, len);
+}
 
-	// Pull SCE/SS high to signal the LCD we are done
-	SET_BIT(PORTD, SCEPIN);
+void lcd_sync(void) {
+	lcd_transport_sync();
 }
 
 void lcd_clear(void) {
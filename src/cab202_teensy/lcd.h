@@ -34,9 +34,17 @@
 #define LCD_Y		48
 
 // Functions for interfacing with the LCD hardware
+// (the byte transport is chosen at build time, see lcd_transport.h)
 void lcd_init(uint8_t contrast);
 void lcd_write(uint8_t dc, uint8_t data);
 void lcd_clear(void);
 void lcd_position(uint8_t x, uint8_t y);
 
+// Send len bytes of pixel data. With a queued transport this returns
+// before the bytes are sent: leave data unchanged until lcd_sync().
+void lcd_write_data(const uint8_t *data, uint8_t len);
+
+// Wait until everything written so far has reached the LCD.
+void lcd_sync(void);
+
 #endif /* LCD_H_ */
@@ -0,0 +1,51 @@
+/*
+ *  CAB202 Teensy Library (cab202_teensy)
+ *	lcd_bitbang.c
+ *
+ *	Software ("bit bashed") LCD transport. See lcd_transport.h.
+ */
+#include "lcd_transport.h"
+
+#if LCD_TRANSPORT == LCD_TRANSPORT_BITBANG
+#include <avr/io.h>
+
+#include "lcd.h"
+#include "macros.h"
+
+void lcd_transport_init(void) {
+	SET_OUTPUT(DDRB, DINPIN);
+	SET_OUTPUT(DDRF, SCKPIN);
+}
+
+void lcd_transport_write(uint8_t dc, uint8_t data) {
+	// Set the DC pin based on the parameter 'dc' (Hint: use the WRITE_BIT macro)
+	WRITE_BIT(PORTB,DCPIN,dc);
+
+	// Pull the SCE/SS pin low to signal the LCD we have data
+	CLEAR_BIT(PORTD,SCEPIN);
+
+	// Write the byte of data using "bit bashing"
+	for(int i = 7; i >= 0; i--) {
+		CLEAR_BIT(PORTF, SCKPIN) ;
+		if((data>>i) & (1 == 1)) {
+			SET_BIT(PORTB, DINPIN);
+		} else {
+			CLEAR_BIT(PORTB, DINPIN);
+		}
+		SET_BIT(PORTF, SCKPIN);
+	}
+
+	// Pull SCE/SS high to signal the LCD we are done
+	SET_BIT(PORTD, SCEPIN);
+}
+
+void lcd_transport_write_data(const uint8_t *data, uint8_t len) {
+	while ( len-- ) {
+		lcd_transport_write(LCD_D, *data++);
+	}
+}
+
+void lcd_transport_sync(void) {
+	// Every write has already completed.
+}
+#endif
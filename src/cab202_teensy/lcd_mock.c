@@ -0,0 +1,92 @@
+/*
+ *  CAB202 Teensy Library (cab202_teensy)
+ *	lcd_mock.c
+ *
+ *	Recording LCD transport for host-side testing. See lcd_transport.h.
+ */
+#include "lcd_transport.h"
+
+#if LCD_TRANSPORT == LCD_TRANSPORT_MOCK
+#include "lcd.h"
+
+uint16_t lcd_mock_log[LCD_MOCK_LOG_SIZE];
+uint16_t lcd_mock_count;
+uint8_t lcd_mock_ram[LCD_Y / 8][LCD_X];
+
+// PCD8544 state needed to place data bytes: address counter and the
+// function set bits (H selects the extended command set, V vertical
+// addressing).
+static uint8_t ram_x, ram_y;
+static uint8_t function_set;
+
+#define FUNCTION_H	0x01
+#define FUNCTION_V	0x02
+
+static void mock_command(uint8_t cmd) {
+	if ( (cmd & 0xF8) == 0x20 ) {
+		function_set = cmd;
+	}
+	else if ( function_set & FUNCTION_H ) {
+		// Extended set: contrast, bias and temperature. No effect on RAM.
+	}
+	else if ( cmd & 0x80 ) {
+		ram_x = cmd & 0x7F;
+	}
+	else if ( cmd & 0x40 ) {
+		ram_y = cmd & 0x07;
+	}
+}
+
+static void mock_data(uint8_t data) {
+	if ( ram_x < LCD_X && ram_y < LCD_Y / 8 ) {
+		lcd_mock_ram[ram_y][ram_x] = data;
+	}
+
+	if ( function_set & FUNCTION_V ) {
+		if ( ++ram_y >= LCD_Y / 8 ) {
+			ram_y = 0;
+			if ( ++ram_x >= LCD_X ) ram_x = 0;
+		}
+	}
+	else {
+		if ( ++ram_x >= LCD_X ) {
+			ram_x = 0;
+			if ( ++ram_y >= LCD_Y / 8 ) ram_y = 0;
+		}
+	}
+}
+
+void lcd_mock_reset(void) {
+	lcd_mock_count = 0;
+	ram_x = 0;
+	ram_y = 0;
+	function_set = 0;
+}
+
+void lcd_transport_init(void) {
+	lcd_mock_reset();
+}
+
+void lcd_transport_write(uint8_t dc, uint8_t data) {
+	if ( lcd_mock_count < LCD_MOCK_LOG_SIZE ) {
+		lcd_mock_log[lcd_mock_count] = ((uint16_t)dc << 8) | data;
+	}
+	lcd_mock_count++;
+
+	if ( dc == LCD_D ) {
+		mock_data(data);
+	}
+	else {
+		mock_command(data);
+	}
+}
+
+void lcd_transport_write_data(const uint8_t *data, uint8_t len) {
+	while ( len-- ) {
+		lcd_transport_write(LCD_D, *data++);
+	}
+}
+
+void lcd_transport_sync(void) {
+}
+#endif
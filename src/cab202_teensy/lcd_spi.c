@@ -0,0 +1,182 @@
+/*
+ *  CAB202 Teensy Library (cab202_teensy)
+ *	lcd_spi.c
+ *
+ *	Interrupt driven hardware SPI LCD transport. See lcd_transport.h.
+ *
+ *	Commands and data spans are queued as jobs; SPI_STC_vect sends the
+ *	next byte each time the previous one has been shifted out. SCE is held
+ *	low from the first queued byte until the queue runs dry.
+ */
+#include "lcd_transport.h"
+
+#if LCD_TRANSPORT == LCD_TRANSPORT_SPI
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+#include "lcd.h"
+#include "macros.h"
+
+// Hardware SPI pins on the ATmega32U4 (PORTB).
+#define SPI_SS_PIN		0
+#define SPI_SCK_PIN		1
+#define SPI_MOSI_PIN	2
+
+#if LCD_SPI_CLOCK_DIV == 2
+#define SPI_CLOCK_BITS	0
+#define SPI_DOUBLE		1
+#elif LCD_SPI_CLOCK_DIV == 4
+#define SPI_CLOCK_BITS	0
+#define SPI_DOUBLE		0
+#elif LCD_SPI_CLOCK_DIV == 8
+#define SPI_CLOCK_BITS	(1 << SPR0)
+#define SPI_DOUBLE		1
+#elif LCD_SPI_CLOCK_DIV == 16
+#define SPI_CLOCK_BITS	(1 << SPR0)
+#define SPI_DOUBLE		0
+#elif LCD_SPI_CLOCK_DIV == 32
+#define SPI_CLOCK_BITS	(1 << SPR1)
+#define SPI_DOUBLE		1
+#elif LCD_SPI_CLOCK_DIV == 64
+#define SPI_CLOCK_BITS	(1 << SPR1)
+#define SPI_DOUBLE		0
+#elif LCD_SPI_CLOCK_DIV == 128
+#define SPI_CLOCK_BITS	((1 << SPR1) | (1 << SPR0))
+#define SPI_DOUBLE		0
+#else
+#error "LCD_SPI_CLOCK_DIV must be 2, 4, 8, 16, 32, 64 or 128"
+#endif
+
+#if LCD_SPI_QUEUE_SIZE & (LCD_SPI_QUEUE_SIZE - 1)
+#error "LCD_SPI_QUEUE_SIZE must be a power of 2"
+#endif
+
+#if !LCD_SPI_BOARD_REWIRED
+#error "LCD_TRANSPORT_SPI drives PB0-PB2, the joystick centre, joystick left and left LED on a stock TeensyPewPew; see lcd_transport.h"
+#endif
+
+#define QUEUE_MASK (LCD_SPI_QUEUE_SIZE - 1)
+
+/*
+ *	A queued transfer. len == 0 means a single byte held in 'byte';
+ *	otherwise 'data' points at len bytes owned by the caller.
+ */
+typedef struct lcd_job_t {
+	uint8_t dc;
+	uint8_t len;
+	union {
+		const uint8_t *data;
+		uint8_t byte;
+	};
+} lcd_job_t;
+
+static lcd_job_t queue[LCD_SPI_QUEUE_SIZE];
+static volatile uint8_t queue_head;	// next free slot (written by caller)
+static volatile uint8_t queue_tail;	// job being sent (advanced by ISR)
+static volatile uint8_t busy;
+static uint8_t job_pos;
+
+static inline uint8_t job_byte(const lcd_job_t *job, uint8_t pos) {
+	return job->len ? job->data[pos] : job->byte;
+}
+
+/*
+ *	Start sending the job at queue_tail. SPI must be idle.
+ */
+static void begin_job(void) {
+	lcd_job_t *job = &queue[queue_tail];
+	WRITE_BIT(PORTB, DCPIN, job->dc);
+	CLEAR_BIT(PORTD, SCEPIN);
+	job_pos = 0;
+	SPDR = job_byte(job, 0);
+}
+
+/*
+ *	Called when the previous byte has been shifted out.
+ */
+static void next_byte(void) {
+	lcd_job_t *job = &queue[queue_tail];
+
+	if ( ++job_pos < job->len ) {
+		SPDR = job->data[job_pos];
+		return;
+	}
+
+	queue_tail = (queue_tail + 1) & QUEUE_MASK;
+
+	if ( queue_tail != queue_head ) {
+		begin_job();
+	}
+	else {
+		SET_BIT(PORTD, SCEPIN);
+		busy = 0;
+	}
+}
+
+ISR(SPI_STC_vect) {
+	next_byte();
+}
+
+/*
+ *	lcd_init() runs before interrupts are enabled in most programs, so
+ *	anything that waits on the ISR services the SPI by polling instead.
+ */
+static inline void poll_if_interrupts_off(void) {
+	if ( !BIT_IS_SET(SREG, SREG_I) && busy && BIT_IS_SET(SPSR, SPIF) ) {
+		(void) SPDR;
+		next_byte();
+	}
+}
+
+static void enqueue(const lcd_job_t *job) {
+	uint8_t next = (queue_head + 1) & QUEUE_MASK;
+
+	while ( next == queue_tail ) {
+		poll_if_interrupts_off();
+	}
+
+	queue[queue_head] = *job;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		queue_head = next;
+
+		if ( !busy ) {
+			busy = 1;
+			begin_job();
+		}
+	}
+}
+
+void lcd_transport_init(void) {
+	SET_OUTPUT(DDRB, SPI_SS_PIN);
+	SET_OUTPUT(DDRB, SPI_SCK_PIN);
+	SET_OUTPUT(DDRB, SPI_MOSI_PIN);
+
+	// Master, mode 0, MSB first, interrupt on transfer complete.
+	SPCR = (1 << SPE) | (1 << MSTR) | (1 << SPIE) | SPI_CLOCK_BITS;
+	SPSR = SPI_DOUBLE << SPI2X;
+}
+
+void lcd_transport_write(uint8_t dc, uint8_t data) {
+	lcd_job_t job = { .dc = dc, .len = 0 };
+	job.byte = data;
+	enqueue(&job);
+}
+
+void lcd_transport_write_data(const uint8_t *data, uint8_t len) {
+	if ( len == 0 ) {
+		return;
+	}
+
+	lcd_job_t job = { .dc = LCD_D, .len = len };
+	job.data = data;
+	enqueue(&job);
+}
+
+void lcd_transport_sync(void) {
+	while ( busy ) {
+		poll_if_interrupts_off();
+	}
+}
+#endif
@@ -0,0 +1,100 @@
+/*
+ *  CAB202 Teensy Library (cab202_teensy)
+ *	lcd_transport.h
+ *
+ *	Byte transport between lcd.c and the Nokia 5110 controller.
+ *	Exactly one backend is compiled in, selected by LCD_TRANSPORT:
+ *
+ *	LCD_TRANSPORT_BITBANG - (default) clocks each bit out on DINPIN/SCKPIN.
+ *		Blocking; works on the stock TeensyPewPew wiring.
+ *	LCD_TRANSPORT_SPI - hardware SPI peripheral, fed from a ring buffer by
+ *		SPI_STC_vect, so lcd_write()/lcd_write_data() return as soon as the
+ *		bytes are queued. Needs DIN on MOSI (PB2) and SCK on SCLK (PB1),
+ *		which the stock board does not do. See the warning below.
+ *	LCD_TRANSPORT_MOCK - no hardware; every byte is appended to
+ *		lcd_mock_log so that a host program can inspect the stream, and
+ *		applied to lcd_mock_ram, a model of the controller's display RAM.
+ */
+#ifndef LCD_TRANSPORT_H_
+#define LCD_TRANSPORT_H_
+
+#include <stdint.h>
+
+#define LCD_TRANSPORT_BITBANG	0
+#define LCD_TRANSPORT_SPI		1
+#define LCD_TRANSPORT_MOCK		2
+
+#ifndef LCD_TRANSPORT
+#define LCD_TRANSPORT LCD_TRANSPORT_BITBANG
+#endif
+
+/*
+ *	Every backend provides these. lcd.c is the only caller.
+ *
+ *	lcd_transport_init - configure pins/peripheral.
+ *	lcd_transport_write - send one byte with the D/C line set to dc.
+ *	lcd_transport_write_data - send len bytes from data with D/C high. The
+ *		bytes may be read after the call returns, so data must stay
+ *		unchanged until lcd_transport_sync() has returned.
+ *	lcd_transport_sync - block until every queued byte has been sent.
+ */
+void lcd_transport_init(void);
+void lcd_transport_write(uint8_t dc, uint8_t data);
+void lcd_transport_write_data(const uint8_t *data, uint8_t len);
+void lcd_transport_sync(void);
+
+#if LCD_TRANSPORT == LCD_TRANSPORT_SPI
+/*
+ *	WARNING: the SPI transport fights the stock TeensyPewPew wiring. It
+ *	drives PB0 (SS, which must be an output in master mode), PB1 (SCLK)
+ *	and PB2 (MOSI) as outputs, but on the stock board these are the
+ *	joystick centre, joystick left and the left LED. The two switches then
+ *	read back whatever the SPI drives, and pressing them shorts an output.
+ *	Only use it on a board with the LCD rewired to MOSI/SCLK and those
+ *	switches moved, and define LCD_SPI_BOARD_REWIRED as 1 to say so;
+ *	lcd_spi.c refuses to build otherwise.
+ */
+#ifndef LCD_SPI_BOARD_REWIRED
+#define LCD_SPI_BOARD_REWIRED	0
+#endif
+
+// SPI clock = F_CPU / LCD_SPI_CLOCK_DIV (2, 4, 8, 16, 32, 64 or 128).
+// Each byte raises one interrupt, so very fast clocks spend more time in
+// the ISR than they save; the PCD8544 tops out at 4MHz anyway.
+#ifndef LCD_SPI_CLOCK_DIV
+#define LCD_SPI_CLOCK_DIV	16
+#endif
+
+// Number of queued transfers (commands or data spans). Must be a power of 2.
+#ifndef LCD_SPI_QUEUE_SIZE
+#define LCD_SPI_QUEUE_SIZE	32
+#endif
+#endif
+
+#if LCD_TRANSPORT == LCD_TRANSPORT_MOCK
+#include "lcd.h"
+
+#ifndef LCD_MOCK_LOG_SIZE
+#define LCD_MOCK_LOG_SIZE	1024
+#endif
+
+/*
+ *	Log of sent bytes: (dc << 8) | data. lcd_mock_count keeps counting past
+ *	LCD_MOCK_LOG_SIZE, but only the first LCD_MOCK_LOG_SIZE are stored.
+ */
+extern uint16_t lcd_mock_log[LCD_MOCK_LOG_SIZE];
+extern uint16_t lcd_mock_count;
+
+/*
+ *	What the panel would show: one byte per column of each 8-pixel bank,
+ *	least significant bit at the top, as written by the data bytes. Kept
+ *	up to date from the X and Y address commands, with horizontal
+ *	addressing. lcd_mock_reset() does not clear it, just as a reset of
+ *	the real controller leaves its RAM undefined.
+ */
+extern uint8_t lcd_mock_ram[LCD_Y / 8][LCD_X];
+
+void lcd_mock_reset(void);
+#endif
+
+#endif /* LCD_TRANSPORT_H_ */
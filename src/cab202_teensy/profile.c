@@ -0,0 +1,49 @@
+/*
+ *  CAB202 Teensy Library (cab202_teensy)
+ *	profile.c
+ *
+ *	Reporting for the phase profiler. See profile.h.
+ */
+
+// Always built, whatever the program's PROFILE setting: these functions
+// only end up in a program that calls them, which it only does with
+// PROFILE on.
+#undef PROFILE
+#define PROFILE 1
+
+#include <avr/pgmspace.h>
+
+#include "profile.h"
+#include "format.h"
+
+void prof_report(uint8_t count, const char *const *names, void (*send)(const char *start, const char *end)) {
+	for ( uint8_t id = 0; id < count; id++ ) {
+		prof_slot_t *slot = &prof_slots[id];
+		char line[48];
+		char *end = FMT_END(line);
+		char *p = fmt_str_P(line, end, PSTR("\r"));
+
+		p = fmt_str_P(p, end, pgm_read_ptr(&names[id]));
+		p = fmt_str_P(p, end, PSTR(" "));
+		p = fmt_uint(p, end, slot->count, 0);
+		p = fmt_str_P(p, end, PSTR(" "));
+		p = fmt_uint(p, end, slot->min, 0);
+		p = fmt_str_P(p, end, PSTR(" "));
+		p = fmt_uint(p, end, slot->count ? slot->total / slot->count : 0, 0);
+		p = fmt_str_P(p, end, PSTR(" "));
+		p = fmt_uint(p, end, slot->max, 0);
+		p = fmt_str_P(p, end, PSTR("\n"));
+		send(line, p);
+	}
+
+	prof_reset(count);
+}
+
+void prof_reset(uint8_t count) {
+	for ( uint8_t id = 0; id < count; id++ ) {
+		prof_slots[id].count = 0;
+		prof_slots[id].min = 0;
+		prof_slots[id].max = 0;
+		prof_slots[id].total = 0;
+	}
+}
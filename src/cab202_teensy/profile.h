@@ -0,0 +1,86 @@
+/*
+ *  CAB202 Teensy Library (cab202_teensy)
+ *	profile.h
+ *
+ *	Phase profiler. PROF_BEGIN(id) and PROF_END(id) around a block of code
+ *	read a free-running 16-bit timer and add the difference to slot id,
+ *	which keeps the number of runs and the minimum, total and maximum
+ *	count. prof_report() prints them and starts again.
+ *
+ *		PROF_BEGIN(PHASE_MOVE);
+ *		move_walls();
+ *		PROF_END(PHASE_MOVE);
+ *
+ *	A block must take less than one timer period (65536 cycles at the
+ *	default rate), and its count includes any interrupts taken meanwhile.
+ *	BEGIN and END must be in the same scope: the start time is a local.
+ *
+ *	The program defines the slots, one per id:
+ *
+ *		prof_slot_t prof_slots[NUM_PHASES];
+ *
+ *	Build options. Define before including, or with -D:
+ *
+ *	PROFILE - 1 to compile the profiler in. When 0 (the default) the
+ *		macros expand to nothing, and a program that only uses the
+ *		macros carries no profiler code or data.
+ *	PROF_TIMER() - expression giving the timer count (default TCNT1,
+ *		which must be running). A host build can supply a fake one.
+ */
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include <stdint.h>
+
+#ifndef PROFILE
+#define PROFILE 0
+#endif
+
+#if PROFILE
+
+#ifndef PROF_TIMER
+#include <avr/io.h>
+#define PROF_TIMER() TCNT1
+#endif
+
+typedef struct prof_slot_t {
+	uint16_t count;		// Runs, stopping at 65535 so total cannot overflow
+	uint16_t min, max;
+	uint32_t total;
+} prof_slot_t;
+
+extern prof_slot_t prof_slots[];
+
+static inline void prof_record(uint8_t id, uint16_t cycles) {
+	prof_slot_t *slot = &prof_slots[id];
+
+	if ( slot->count == UINT16_MAX ) return;
+	if ( slot->count == 0 || cycles < slot->min ) slot->min = cycles;
+	if ( cycles > slot->max ) slot->max = cycles;
+	slot->total += cycles;
+	slot->count++;
+}
+
+#define PROF_BEGIN(id)	uint16_t prof_start_ ## id = PROF_TIMER()
+#define PROF_END(id)	prof_record((id), (uint16_t)(PROF_TIMER() - prof_start_ ## id))
+
+/*
+ *	Print one line per slot, "<name> <runs> <min> <avg> <max>" with counts
+ *	in timer ticks, then empty the slots. names is a flash array of count
+ *	flash strings. send is given each line as a [start, end) span.
+ */
+void prof_report(uint8_t count, const char *const *names, void (*send)(const char *start, const char *end));
+
+/*
+ *	Empty the first count slots.
+ */
+void prof_reset(uint8_t count);
+
+#else
+
+#define PROF_BEGIN(id)	do { } while (0)
+#define PROF_END(id)	do { } while (0)
+
+#endif
+
+#endif /* PROFILE_H_ */
@@ -7,6 +7,47 @@
  */
 #include "ram_utils.h"
 
+/*
+ * Paint from the end of .bss to the top of RAM. Runs from .init1, where
+ * nothing is on the stack yet and r1 is not yet zero, hence assembler.
+ * The linker keeps it whenever ram_usage() pulls this file in.
+ */
+void ram_paint(void) __attribute__((naked, used, section(".init1")));
+
+void ram_paint(void) {
+	__asm__ __volatile__ (
+		"ldi r30, lo8(_end)"		"\n\t"
+		"ldi r31, hi8(_end)"		"\n\t"
+		"ldi r24, %0"				"\n\t"
+		"ldi r25, hi8(__stack)"		"\n\t"
+		"rjmp 2f"					"\n"
+		"1:"						"\n\t"
+		"st Z+, r24"				"\n"
+		"2:"						"\n\t"
+		"cpi r30, lo8(__stack)"		"\n\t"
+		"cpc r31, r25"				"\n\t"
+		"brlo 1b"					"\n\t"
+		"breq 1b"					"\n\t"
+		:: "M" (RAM_PAINT)
+	);
+}
+
+void ram_usage(ram_usage_t *usage) {
+	extern uint8_t __heap_start;
+	extern uint8_t *__brkval;
+	uint8_t *heap_top = __brkval == 0 ? &__heap_start : __brkval;
+	uint8_t *p = heap_top;
+
+	// Stop at the stack pointer in case the stack has met the heap.
+	while ( p < (uint8_t *)SP && *p == RAM_PAINT ) {
+		p++;
+	}
+
+	usage->heap_top = (uint16_t)heap_top;
+	usage->stack_low = (uint16_t)p;
+	usage->free_gap = p - heap_top;
+}
+
 #if WANT_ESTIMATE_ALLOC
 int estimate_alloc(int len){
 	extern int __heap_start, *__brkval;
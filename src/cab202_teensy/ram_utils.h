@@ -8,6 +8,7 @@
 #ifndef RAM_UTILS_H_
 #define RAM_UTILS_H_
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <avr/io.h>
 #include <avr/pgmspace.h>
@@ -21,6 +22,30 @@
 int estimate_alloc(int len);
 int estimate_ram(void);
 #endif
+
+/*
+ * RAM usage. The gap between .bss and the top of RAM is painted with
+ * RAM_PAINT during start-up, before .data and .bss are set up, so the
+ * lowest byte the stack has ever changed can be found later. A stack
+ * byte that happens to hold RAM_PAINT reads as unused, so stack_low
+ * may be a byte or two high.
+ *
+ * heap_top - first byte above .data, .bss and the heap.
+ * stack_low - lowest address the stack has written since reset.
+ * free_gap - bytes between the two that nothing has written yet.
+ *
+ * ram_usage() scans the gap, about 5 cycles per free byte.
+ */
+#define RAM_PAINT 0xC5
+
+typedef struct {
+	uint16_t heap_top;
+	uint16_t stack_low;
+	uint16_t free_gap;
+} ram_usage_t;
+
+void ram_usage(ram_usage_t *usage);
+
 unsigned char* load_rom_bitmap(const unsigned char* source, int len);
 unsigned char* load_rom_string(const unsigned char* source);
 
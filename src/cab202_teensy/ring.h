@@ -0,0 +1,107 @@
+/*
+ *  CAB202 Teensy Library (cab202_teensy)
+ *	ring.h
+ *
+ *	Lock-free single-producer/single-consumer byte ring, for passing data
+ *	between an interrupt handler and the main loop without disabling
+ *	interrupts. One side only ever calls ring_put(), the other only
+ *	ring_get(); each owns one index, and 8-bit index updates are atomic
+ *	on the AVR.
+ *
+ *	The buffer size must be a power of two, at most 128.
+ *
+ *	Example:
+ *		static uint8_t rx_buffer[32];
+ *		ring_t rx = RING_INIT(rx_buffer);
+ */
+#ifndef RING_H_
+#define RING_H_
+
+#include <stdint.h>
+
+typedef struct ring_t {
+	uint8_t *buffer;
+	uint8_t mask;
+	// Free-running counts of bytes written and read; wrap at 256.
+	volatile uint8_t head, tail;
+} ring_t;
+
+#define RING_INIT(buf) { (buf), sizeof(buf) - 1, 0, 0 }
+
+// Stop the compiler moving buffer accesses across index reads and updates.
+#define RING_BARRIER() __asm__ __volatile__ ("" ::: "memory")
+
+/*
+ *	Number of bytes waiting to be read.
+ */
+static inline uint8_t ring_count(const ring_t *ring) {
+	return (uint8_t)(ring->head - ring->tail);
+}
+
+/*
+ *	Number of bytes that can be written before the ring is full.
+ */
+static inline uint8_t ring_free(const ring_t *ring) {
+	return ring->mask + 1 - ring_count(ring);
+}
+
+/*
+ *	Producer side: append a byte. Returns 0, dropping the byte, if full.
+ */
+static inline uint8_t ring_put(ring_t *ring, uint8_t byte) {
+	uint8_t head = ring->head;
+	if ( (uint8_t)(head - ring->tail) > ring->mask ) {
+		return 0;
+	}
+	ring->buffer[head & ring->mask] = byte;
+	RING_BARRIER();
+	ring->head = head + 1;
+	return 1;
+}
+
+/*
+ *	Consumer side: take the oldest byte. Returns 0 if empty.
+ */
+static inline uint8_t ring_get(ring_t *ring, uint8_t *byte) {
+	uint8_t tail = ring->tail;
+	if ( ring->head == tail ) {
+		return 0;
+	}
+	// The slot is only valid once head has been seen to pass it.
+	RING_BARRIER();
+	*byte = ring->buffer[tail & ring->mask];
+	RING_BARRIER();
+	ring->tail = tail + 1;
+	return 1;
+}
+
+/*
+ *	Consumer side: look at the oldest byte without taking it, for when the
+ *	destination may refuse it. Returns 0 if empty.
+ */
+static inline uint8_t ring_peek(const ring_t *ring, uint8_t *byte) {
+	uint8_t tail = ring->tail;
+	if ( ring->head == tail ) {
+		return 0;
+	}
+	RING_BARRIER();
+	*byte = ring->buffer[tail & ring->mask];
+	return 1;
+}
+
+/*
+ *	Consumer side: drop the oldest byte, after ring_peek() found one.
+ */
+static inline void ring_skip(ring_t *ring) {
+	RING_BARRIER();
+	ring->tail++;
+}
+
+/*
+ *	Consumer side: discard everything waiting.
+ */
+static inline void ring_flush(ring_t *ring) {
+	ring->tail = ring->head;
+}
+
+#endif /* RING_H_ */
@@ -0,0 +1,129 @@
+/*
+ *  CAB202 Teensy Library (cab202_teensy)
+ *	sampler.c
+ *
+ *	Statistical profiler. See sampler.h.
+ */
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+#include "sampler.h"
+#include "ring.h"
+
+static uint8_t queue_buffer[SAMPLER_QUEUE_SIZE];
+static ring_t queue = RING_INIT(queue_buffer);
+static volatile uint16_t dropped;
+static uint16_t lfsr = 0xACE1;
+
+void sampler_start(void) {
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		OCR3A = TCNT3 + SAMPLER_INTERVAL;
+		TIFR3 = 1 << OCF3A;
+		TIMSK3 |= 1 << OCIE3A;
+	}
+}
+
+void sampler_stop(void) {
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		TIMSK3 &= ~(1 << OCIE3A);
+	}
+}
+
+uint8_t sampler_take(uint16_t *samples, uint8_t max) {
+	uint8_t n = 0;
+	uint8_t lo, hi;
+
+	// The handler queues both bytes of a sample before we can run.
+	while ( n < max && ring_count(&queue) >= 2 ) {
+		ring_get(&queue, &lo);
+		ring_get(&queue, &hi);
+		samples[n++] = lo | (hi << 8);
+	}
+	return n;
+}
+
+void sampler_lost(uint16_t count) {
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		dropped += count;
+	}
+}
+
+uint16_t sampler_dropped(void) {
+	uint16_t count;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		count = dropped;
+	}
+	return count;
+}
+
+/*
+ *	Called from the interrupt handler below with the interrupted program
+ *	counter, a word address.
+ */
+void sampler_record(uint16_t pc) __attribute__((used));
+
+void sampler_record(uint16_t pc) {
+	// Galois LFSR (taps 16, 14, 13, 11) for the next interval.
+	lfsr = (lfsr >> 1) ^ (-(lfsr & 1) & 0xB400);
+	OCR3A += SAMPLER_INTERVAL / 2 + (lfsr & (SAMPLER_INTERVAL - 1));
+
+	if ( ring_free(&queue) < 2 ) {
+		dropped++;
+		return;
+	}
+	pc <<= 1;
+	ring_put(&queue, pc);
+	ring_put(&queue, pc >> 8);
+}
+
+/*
+ *	The return address is on the stack under whatever the handler pushes,
+ *	so the prologue is written out here to know its depth: SREG and the
+ *	registers a C function may clobber, 15 bytes. The address was pushed
+ *	low byte first, so it reads big-endian at SP+16. The ATmega32U4 has a
+ *	16-bit program counter.
+ */
+ISR(TIMER3_COMPA_vect, ISR_NAKED) {
+	__asm__ __volatile__ (
+		"push r0"				"\n\t"
+		"in r0, __SREG__"		"\n\t"
+		"push r0"				"\n\t"
+		"push r1"				"\n\t"
+		"clr r1"				"\n\t"
+		"push r18"				"\n\t"
+		"push r19"				"\n\t"
+		"push r20"				"\n\t"
+		"push r21"				"\n\t"
+		"push r22"				"\n\t"
+		"push r23"				"\n\t"
+		"push r24"				"\n\t"
+		"push r25"				"\n\t"
+		"push r26"				"\n\t"
+		"push r27"				"\n\t"
+		"push r30"				"\n\t"
+		"push r31"				"\n\t"
+		"in r30, __SP_L__"		"\n\t"
+		"in r31, __SP_H__"		"\n\t"
+		"ldd r25, Z+16"			"\n\t"
+		"ldd r24, Z+17"			"\n\t"
+		"call sampler_record"	"\n\t"
+		"pop r31"				"\n\t"
+		"pop r30"				"\n\t"
+		"pop r27"				"\n\t"
+		"pop r26"				"\n\t"
+		"pop r25"				"\n\t"
+		"pop r24"				"\n\t"
+		"pop r23"				"\n\t"
+		"pop r22"				"\n\t"
+		"pop r21"				"\n\t"
+		"pop r20"				"\n\t"
+		"pop r19"				"\n\t"
+		"pop r18"				"\n\t"
+		"pop r1"				"\n\t"
+		"pop r0"				"\n\t"
+		"out __SREG__, r0"		"\n\t"
+		"pop r0"				"\n\t"
+		"reti"					"\n\t"
+	);
+}
@@ -0,0 +1,73 @@
+/*
+ *  CAB202 Teensy Library (cab202_teensy)
+ *	sampler.h
+ *
+ *	Statistical profiler. Timer 3's compare A interrupt fires at irregular
+ *	intervals averaging SAMPLER_INTERVAL cycles and records the address it
+ *	interrupted, so the number of samples landing in a function is in
+ *	proportion to the time spent there, library code included. The main
+ *	loop takes the addresses with sampler_take() and sends them on; the
+ *	histogram is built by the receiver (tools/sample_profile.py), as there
+ *	is no room for one here.
+ *
+ *	The intervals vary between 1/2 and 3/2 of the mean so that samples do
+ *	not lock onto anything periodic, such as the frame rate. Code that
+ *	runs with interrupts off, including other interrupt handlers, is
+ *	charged to the instruction after it.
+ *
+ *	Timer 3 must be running in normal mode with no prescaler (the game
+ *	clock), and other code must only touch its 16-bit registers with
+ *	interrupts off, since the handler writes OCR3A.
+ *
+ *	Build options. Define with -D:
+ *
+ *	SAMPLER - 1 to build the sampler into the program; the program checks
+ *		this (default 0).
+ *	SAMPLER_INTERVAL - mean cycles between samples, a power of two
+ *		(default 8192, about 1 kHz at 8 MHz).
+ *	SAMPLER_QUEUE_SIZE - bytes of samples waiting for sampler_take(), two
+ *		per sample; a power of two, at most 128 (default 128).
+ */
+#ifndef SAMPLER_H_
+#define SAMPLER_H_
+
+#include <stdint.h>
+
+#ifndef SAMPLER
+#define SAMPLER 0
+#endif
+
+#ifndef SAMPLER_INTERVAL
+#define SAMPLER_INTERVAL 8192
+#endif
+
+#ifndef SAMPLER_QUEUE_SIZE
+#define SAMPLER_QUEUE_SIZE 128
+#endif
+
+/*
+ *	Start or stop taking samples. Samples still queued stay queued.
+ */
+void sampler_start(void);
+void sampler_stop(void);
+
+/*
+ *	Move up to max queued samples, oldest first, into samples. Each is the
+ *	byte address in flash of the instruction that was interrupted.
+ *	Returns the number moved.
+ */
+uint8_t sampler_take(uint16_t *samples, uint8_t max);
+
+/*
+ *	Count count samples, already taken, as lost: for when they could not
+ *	be passed on.
+ */
+void sampler_lost(uint16_t count);
+
+/*
+ *	Samples lost since start-up, because the queue was full or as
+ *	reported by sampler_lost().
+ */
+uint16_t sampler_dropped(void);
+
+#endif /* SAMPLER_H_ */
@@ -0,0 +1,18 @@
+/*
+ *  CAB202 Teensy Library (cab202_teensy)
+ *	sprite.c
+ *
+ *	Flash-resident 1-bit sprites. See sprite.h.
+ */
+#include "sprite.h"
+#include "graphics.h"
+
+void draw_sprite(int x, int y, const sprite_t *sprite) {
+	uint8_t width = pgm_read_byte(&sprite->width);
+	const uint8_t *column = sprite->columns;
+
+	for ( uint8_t i = 0; i < width; i++, x++ ) {
+		uint8_t bits = pgm_read_byte(column++);
+		draw_column(x, y, bits, bits);
+	}
+}
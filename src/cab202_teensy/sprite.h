@@ -0,0 +1,68 @@
+/*
+ *  CAB202 Teensy Library (cab202_teensy)
+ *	sprite.h
+ *
+ *	Small 1-bit-per-pixel bitmaps stored in flash, packed the same way as
+ *	the LCD: one byte per column, top pixel in bit 0.
+ */
+#ifndef SPRITE_H_
+#define SPRITE_H_
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+/*
+ *	Widest sprite supported. Sprites are at most 8 pixels high.
+ */
+#define SPRITE_MAX_WIDTH 8
+
+/*
+ *	A sprite. Define instances with SPRITE() and PROGMEM.
+ */
+typedef struct sprite_t {
+	uint8_t width;
+	uint8_t height;
+	uint8_t columns[SPRITE_MAX_WIDTH];
+} sprite_t;
+
+/*
+ *	Build a sprite_t initialiser from its rows, top row first. Each row is
+ *	a width-bit number whose most significant bit is the left-most pixel,
+ *	so a binary literal reads like the picture:
+ *
+ *		const sprite_t box PROGMEM = SPRITE(3, 3, 0b111, 0b101, 0b111);
+ */
+#define SPRITE(width, height, ...) \
+	SPRITE_(width, height, __VA_ARGS__, 0, 0, 0, 0, 0, 0, 0, 0)
+
+// Implementation of SPRITE(): transposes rows r0..r7 into column bytes.
+#define SPRITE_(w, h, r0, r1, r2, r3, r4, r5, r6, r7, ...) { (w), (h), { \
+	SPRITE_COLUMN(w, 0, r0, r1, r2, r3, r4, r5, r6, r7), \
+	SPRITE_COLUMN(w, 1, r0, r1, r2, r3, r4, r5, r6, r7), \
+	SPRITE_COLUMN(w, 2, r0, r1, r2, r3, r4, r5, r6, r7), \
+	SPRITE_COLUMN(w, 3, r0, r1, r2, r3, r4, r5, r6, r7), \
+	SPRITE_COLUMN(w, 4, r0, r1, r2, r3, r4, r5, r6, r7), \
+	SPRITE_COLUMN(w, 5, r0, r1, r2, r3, r4, r5, r6, r7), \
+	SPRITE_COLUMN(w, 6, r0, r1, r2, r3, r4, r5, r6, r7), \
+	SPRITE_COLUMN(w, 7, r0, r1, r2, r3, r4, r5, r6, r7) } }
+
+#define SPRITE_COLUMN(w, c, r0, r1, r2, r3, r4, r5, r6, r7) ((c) < (w) ? ( \
+	SPRITE_BIT(w, c, r0) << 0 | SPRITE_BIT(w, c, r1) << 1 | \
+	SPRITE_BIT(w, c, r2) << 2 | SPRITE_BIT(w, c, r3) << 3 | \
+	SPRITE_BIT(w, c, r4) << 4 | SPRITE_BIT(w, c, r5) << 5 | \
+	SPRITE_BIT(w, c, r6) << 6 | SPRITE_BIT(w, c, r7) << 7) : 0)
+
+#define SPRITE_BIT(w, c, row) (((row) >> ((w) - 1 - (c) % (w))) & 1)
+
+/**
+ *	Draw the set pixels of a sprite into the screen buffer. Clear pixels
+ *	are left alone (transparent background).
+ *
+ *	Parameters:
+ *		x - The horizontal position of the top-left corner of the sprite.
+ *		y - The vertical position of the top-left corner of the sprite.
+ *		sprite - Address of a sprite_t in PROGMEM.
+ */
+void draw_sprite(int x, int y, const sprite_t *sprite);
+
+#endif /* SPRITE_H_ */
@@ -0,0 +1,59 @@
+/*
+ *  CAB202 Teensy Library (cab202_teensy)
+ *	telemetry.c
+ *
+ *	Buffered binary framing. See telemetry.h.
+ */
+#include <util/crc16.h>
+
+#include "telemetry.h"
+#include "ring.h"
+
+static uint8_t buffer[TELEMETRY_BUFFER_SIZE];
+static ring_t tx = RING_INIT(buffer);
+static uint16_t dropped = 0;
+
+uint8_t telemetry_send(uint8_t type, const void *payload, uint8_t length) {
+	// The ring has a single producer, so space checked here stays free.
+	if ( length > TELEMETRY_MAX_PAYLOAD || ring_free(&tx) < length + TELEMETRY_OVERHEAD ) {
+		dropped++;
+		return 0;
+	}
+
+	const uint8_t *bytes = payload;
+	uint16_t crc = 0xFFFF;
+
+	ring_put(&tx, TELEMETRY_SYNC);
+	ring_put(&tx, length);
+	crc = _crc_ccitt_update(crc, length);
+	ring_put(&tx, type);
+	crc = _crc_ccitt_update(crc, type);
+
+	for ( uint8_t i = 0; i < length; i++ ) {
+		ring_put(&tx, bytes[i]);
+		crc = _crc_ccitt_update(crc, bytes[i]);
+	}
+
+	ring_put(&tx, crc & 0xFF);
+	ring_put(&tx, crc >> 8);
+	return 1;
+}
+
+uint8_t telemetry_drain(int8_t (*put)(uint8_t), uint8_t max) {
+	uint8_t sent = 0;
+	uint8_t byte;
+
+	while ( sent < max && ring_peek(&tx, &byte) ) {
+		if ( put(byte) < 0 ) {
+			break;
+		}
+		ring_skip(&tx);
+		sent++;
+	}
+
+	return sent;
+}
+
+uint16_t telemetry_dropped(void) {
+	return dropped;
+}
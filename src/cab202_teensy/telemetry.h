@@ -0,0 +1,61 @@
+/*
+ *  CAB202 Teensy Library (cab202_teensy)
+ *	telemetry.h
+ *
+ *	Framed binary records, queued so that sending never blocks. Frames
+ *	are written to a ring buffer by the main loop and moved to the
+ *	output (e.g. USB serial) from an interrupt by telemetry_drain().
+ *	A frame that does not fit is dropped whole, never truncated.
+ *
+ *	Frame layout:
+ *		0xA5			sync byte
+ *		length			payload length n, 0..TELEMETRY_MAX_PAYLOAD
+ *		type			record type, chosen by the application
+ *		payload			n bytes
+ *		crc				CRC-16 over length, type and payload, low byte first
+ *
+ *	The CRC is avr-libc's _crc_ccitt_update() starting from 0xFFFF
+ *	(reflected polynomial 0x8408, no final XOR). Receivers find frames by
+ *	scanning for the sync byte and checking the CRC, so frames can share
+ *	a stream with plain text.
+ */
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#include <stdint.h>
+
+/*
+ *	Build options. Define with -D:
+ *
+ *	TELEMETRY_BUFFER_SIZE - bytes queued for output; a power of two, at
+ *		most 128 (default 128).
+ */
+#ifndef TELEMETRY_BUFFER_SIZE
+#define TELEMETRY_BUFFER_SIZE 128
+#endif
+
+#define TELEMETRY_SYNC 0xA5
+#define TELEMETRY_OVERHEAD 5
+#define TELEMETRY_MAX_PAYLOAD (TELEMETRY_BUFFER_SIZE - TELEMETRY_OVERHEAD)
+
+/*
+ *	Queue one frame. Returns 0, and counts a drop, if it does not fit.
+ *	Call from one context only (normally the main loop).
+ */
+uint8_t telemetry_send(uint8_t type, const void *payload, uint8_t length);
+
+/*
+ *	Pass up to max queued bytes to put(), stopping early if put() returns
+ *	a negative value; the refused byte stays queued. Returns the number of
+ *	bytes passed. Call from one context only (normally an interrupt).
+ *
+ *	usb_serial_putchar_nowait() is a suitable put().
+ */
+uint8_t telemetry_drain(int8_t (*put)(uint8_t), uint8_t max);
+
+/*
+ *	Number of frames dropped because the buffer was full.
+ */
+uint16_t telemetry_dropped(void);
+
+#endif /* TELEMETRY_H_ */
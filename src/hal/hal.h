@@ -0,0 +1,121 @@
+/*
+ *	Tom and Jerry on the Teensy
+ *	hal.h
+ *
+ *	Hardware abstraction layer: switches, LEDs, the game clock and the
+ *	periodic interrupts. Everything else the game touches already has a
+ *	portable interface (lcd_transport.h, usb_serial.h, cab202_adc.h).
+ *	Exactly one backend is compiled in:
+ *
+ *	hal_teensy.c - (default) the TeensyPewPew board. hal_switches() and
+ *		hal_leds() are inline register accesses, so the interrupt hooks
+ *		cost the same as code written against the registers.
+ *	hal_host.c - Linux, selected with -DHAL_HOST. Time is simulated and
+ *		only moves forward in hal_wait(), so the game runs as fast as the
+ *		host allows. Switches and thumbwheels follow a script, the LCD is
+ *		the display model in lcd_mock.c and serial I/O is stdin/stdout.
+ *		See hal_host.c for the script format.
+ *
+ *	The backend calls two hooks, which the game must define:
+ *
+ *	hal_pwm_hook - every 256 CPU cycles (31.25 kHz), for LED brightness.
+ *	hal_input_hook - every 65536 CPU cycles (~122 Hz), to sample the
+ *		switches and serial input. The thumbwheels are converted at the
+ *		same rate when adc_start() is given ADC_TRIGGER_TIMER1_OVF.
+ */
+#ifndef HAL_H_
+#define HAL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ *	Switch bits in the value returned by hal_switches().
+ */
+#define SW1			0	// Left button
+#define SW2			1	// Right button
+#define SWA			2	// Joystick down
+#define SWB			3	// Joystick left
+#define SWC			4	// Joystick up
+#define SWD			5	// Joystick right
+#define SWCENTER	6	// Joystick centre
+
+/*
+ *	Set the CPU clock, switch and LED pins and start the timers behind the
+ *	hooks. Enables interrupts.
+ */
+void hal_init(void);
+
+/*
+ *	The game clock counts CPU cycles as a number of 65536-cycle overflows
+ *	plus a 16-bit counter. It reads zero until hal_clock_start().
+ *
+ *	hal_clock_start - start counting from zero.
+ *	hal_clock_reset - set the overflow count back to zero.
+ *	hal_clock_read - read the overflow count and counter as one consistent
+ *		pair, allowing for an overflow that has not been counted yet.
+ */
+void hal_clock_start(void);
+void hal_clock_reset(void);
+void hal_clock_read(uint32_t *count, uint16_t *tcnt);
+
+/*
+ *	A fast-changing byte for seeding rand().
+ */
+uint8_t hal_entropy(void);
+
+void hal_pwm_hook(void);
+void hal_input_hook(void);
+
+/*
+ *	The rest are inline on the Teensy.
+ *
+ *	hal_timer - free-running 16-bit count of CPU cycles, for timing
+ *		stretches of code shorter than 65536 cycles (the profiler's
+ *		PROF_TIMER). The host backend counts host time instead, in the
+ *		same 8 MHz units, because simulated time stands still while the
+ *		game computes.
+ *	hal_switches - the switches that are down, as SW1..SWCENTER bits.
+ *	hal_leds - turn both LEDs on or off.
+ *	hal_wait - call from every loop that waits for the clock or a switch.
+ *		On the host it advances simulated time and runs the hooks and
+ *		script events that fall due; on the Teensy it does nothing.
+ */
+#ifdef HAL_HOST
+uint16_t hal_timer(void);
+uint8_t hal_switches(void);
+void hal_leds(bool on);
+void hal_wait(void);
+#else
+#include <avr/io.h>
+
+// Timer 1 runs from hal_init() with no prescaler.
+static inline uint16_t hal_timer(void) {
+	return TCNT1;
+}
+
+static inline uint8_t hal_switches(void) {
+	uint8_t pinb = PINB;
+	uint8_t pind = PIND;
+	return ((PINF >> 5) & 0b11)			// SW1, SW2 = PF5, PF6
+		| ((pinb >> 5) & 0b100)			// SWA = PB7
+		| ((pinb << 2) & 0b1000)		// SWB = PB1
+		| ((pind << 3) & 0b10000)		// SWC = PD1
+		| ((pind << 5) & 0b100000)		// SWD = PD0
+		| ((pinb << 6) & 0b1000000);	// SWCENTER = PB0
+}
+
+static inline void hal_leds(bool on) {
+	if ( on ) {
+		PORTB |= (1 << 2) | (1 << 3);
+	}
+	else {
+		PORTB &= ~((1 << 2) | (1 << 3));
+	}
+}
+
+static inline void hal_wait(void) {
+}
+#endif
+
+#endif /* HAL_H_ */
@@ -0,0 +1,399 @@
+/*
+ *	Tom and Jerry on the Teensy
+ *	hal_host.c
+ *
+ *	Linux backend for hal.h, plus host versions of the usb_serial,
+ *	cab202_adc and ram_usage() interfaces. Build with -DHAL_HOST and
+ *	-DLCD_TRANSPORT=LCD_TRANSPORT_MOCK; see "make host".
+ *
+ *	Time is a simulated count of 8 MHz CPU cycles. It stands still while
+ *	the game computes and moves 256 cycles (one Timer 0 period) per call
+ *	to hal_wait(), running hal_pwm_hook(), hal_input_hook() and the 1 ms
+ *	USB frame hook as their periods come round. A game that spends its
+ *	spare time waiting therefore runs as fast as the host can compute
+ *	frames, and runs the same way every time.
+ *
+ *	Serial output goes to stdout. Serial input is the script's "send"
+ *	text followed by whatever arrives on stdin; give it /dev/null (or a
+ *	pty) when none is wanted.
+ *
+ *	Input script: the file named by the HAL_SCRIPT environment variable.
+ *	One event per line, "<ms> <command> [arguments]", with ms counted
+ *	from hal_init() and never decreasing. Events take effect at the next
+ *	input sample, within 8.2 ms. Blank lines and lines starting with '#'
+ *	are ignored.
+ *
+ *	press <switch>...	hold switches down: sw1, sw2, down, left, up,
+ *						right, centre
+ *	release <switch>...	let them go
+ *	wheel <channel> <value>	ADC reading for a thumbwheel (0..1023;
+ *						both default to 512)
+ *	send <text>			queue serial input; \n, \r, \t, \\ and \xHH
+ *						escapes are understood
+ *	seed <n>			restart the hal_entropy() sequence
+ *	screen				print the LCD contents to stderr
+ *	quit				flush the output and exit with status 0
+ *
+ *	Without a script the switches stay up and the game runs until killed.
+ */
+#ifdef HAL_HOST
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <lcd.h>
+#include <lcd_transport.h>
+#include <usb_serial.h>
+#include <cab202_adc.h>
+#include <ram_utils.h>
+
+#include "hal.h"
+
+// Port registers for library pin setup; see host/avr/io.h.
+volatile uint8_t PINB, PINC, PIND, PINE, PINF;
+volatile uint8_t DDRB, DDRC, DDRD, DDRE, DDRF;
+volatile uint8_t PORTB, PORTC, PORTD, PORTE, PORTF;
+
+#define CYCLES_PER_MS	(F_CPU / 1000)
+#define PWM_PERIOD		256
+#define INPUT_PERIOD	65536
+#define SOF_PERIOD		CYCLES_PER_MS
+
+#define ADC_CHANNELS	8
+
+// Serial input waiting for usb_serial_getchar(). Must be a power of 2.
+#define SERIAL_QUEUE_SIZE	1024
+
+static uint64_t now;			// Simulated cycles since hal_init()
+static uint64_t next_input, next_sof;
+static uint64_t clock_origin;	// Value of now when the game clock read 0
+static bool clock_running;
+
+static uint8_t switches;
+static bool leds_on;
+static uint32_t entropy = 1;
+static uint16_t adc_values[ADC_CHANNELS];
+
+static uint8_t serial_queue[SERIAL_QUEUE_SIZE];
+static uint16_t serial_head, serial_tail;
+static bool stdin_open = true;
+static bool output_pending;
+
+static FILE *script;
+static const char *script_name;
+static unsigned script_line;
+static char script_buffer[256];
+static uint64_t script_due;		// Cycle at which script_buffer runs
+static bool script_waiting;		// script_buffer holds the next event
+
+/*
+ *	Script.
+ */
+
+static void script_error(const char *message) {
+	fprintf(stderr, "%s:%u: %s\n", script_name, script_line, message);
+	exit(1);
+}
+
+// Read the next event into script_buffer, or close the script at its end.
+static void script_next(void) {
+	script_waiting = false;
+
+	while ( fgets(script_buffer, sizeof(script_buffer), script) ) {
+		script_line++;
+		script_buffer[strcspn(script_buffer, "\r\n")] = 0;
+
+		char *p = script_buffer + strspn(script_buffer, " \t");
+		if ( *p == 0 || *p == '#' ) continue;
+
+		char *end;
+		unsigned long long ms = strtoull(p, &end, 10);
+		if ( end == p ) script_error("expected a time in milliseconds");
+		uint64_t due = ms * CYCLES_PER_MS;
+		if ( due < script_due ) script_error("time goes backwards");
+
+		memmove(script_buffer, end, strlen(end) + 1);
+		script_due = due;
+		script_waiting = true;
+		return;
+	}
+
+	fclose(script);
+	script = NULL;
+}
+
+static uint8_t switch_bit(const char *name) {
+	static const char *const names[] = {
+		[SW1] = "sw1", [SW2] = "sw2", [SWA] = "down", [SWB] = "left",
+		[SWC] = "up", [SWD] = "right", [SWCENTER] = "centre",
+	};
+
+	for ( uint8_t i = 0; i < sizeof(names) / sizeof(names[0]); i++ ) {
+		if ( strcmp(name, names[i]) == 0 ) return 1 << i;
+	}
+	script_error("unknown switch");
+	return 0;
+}
+
+static void serial_queue_put(uint8_t c) {
+	if ( (uint16_t)(serial_head - serial_tail) >= SERIAL_QUEUE_SIZE ) {
+		script_error("serial input queue full");
+	}
+	serial_queue[serial_head++ & (SERIAL_QUEUE_SIZE - 1)] = c;
+}
+
+static void queue_text(const char *text) {
+	while ( *text ) {
+		char c = *text++;
+		if ( c == '\\' ) {
+			c = *text++;
+			if ( c == 'n' ) c = '\n';
+			else if ( c == 'r' ) c = '\r';
+			else if ( c == 't' ) c = '\t';
+			else if ( c == 'x' ) {
+				char *end;
+				char hex[3] = { text[0], text[0] ? text[1] : 0, 0 };
+				c = (char)strtoul(hex, &end, 16);
+				if ( end == hex ) script_error("bad \\x escape");
+				text += end - hex;
+			}
+			else if ( c != '\\' ) script_error("unknown escape");
+		}
+		serial_queue_put(c);
+	}
+}
+
+static void print_screen(void) {
+	fprintf(stderr, "-- %llu ms, LEDs %s --\n", (unsigned long long)(now / CYCLES_PER_MS), leds_on ? "on" : "off");
+	for ( uint8_t y = 0; y < LCD_Y; y++ ) {
+		char row[LCD_X + 1];
+		for ( uint8_t x = 0; x < LCD_X; x++ ) {
+			row[x] = (lcd_mock_ram[y / 8][x] >> (y % 8)) & 1 ? '#' : '.';
+		}
+		row[LCD_X] = 0;
+		fprintf(stderr, "%s\n", row);
+	}
+}
+
+static void script_run(const char *command) {
+	const char *delims = " \t";
+	char *args = (char *)command + strspn(command, delims);
+	char *name = strsep(&args, delims);
+
+	if ( strcmp(name, "press") == 0 || strcmp(name, "release") == 0 ) {
+		bool press = name[0] == 'p';
+		char *sw;
+		while ( args && (sw = strsep(&args, delims)) ) {
+			if ( *sw == 0 ) continue;
+			if ( press ) switches |= switch_bit(sw);
+			else switches &= ~switch_bit(sw);
+		}
+	}
+	else if ( strcmp(name, "wheel") == 0 ) {
+		unsigned channel, value;
+		if ( !args || sscanf(args, "%u %u", &channel, &value) != 2 || channel >= ADC_CHANNELS || value > 1023 ) {
+			script_error("usage: wheel <channel> <0..1023>");
+		}
+		adc_values[channel] = value;
+	}
+	else if ( strcmp(name, "send") == 0 ) {
+		queue_text(args ? args : "");
+	}
+	else if ( strcmp(name, "seed") == 0 ) {
+		entropy = args ? strtoul(args, NULL, 0) : 1;
+	}
+	else if ( strcmp(name, "screen") == 0 ) {
+		print_screen();
+	}
+	else if ( strcmp(name, "quit") == 0 ) {
+		fflush(stdout);
+		exit(0);
+	}
+	else {
+		script_error("unknown command");
+	}
+}
+
+static void script_poll(void) {
+	while ( script_waiting && script_due <= now ) {
+		script_run(script_buffer);
+		script_next();
+	}
+}
+
+/*
+ *	hal.h
+ */
+
+void hal_init(void) {
+	for ( uint8_t i = 0; i < ADC_CHANNELS; i++ ) {
+		adc_values[i] = 512;
+	}
+
+	script_name = getenv("HAL_SCRIPT");
+	if ( script_name ) {
+		script = fopen(script_name, "r");
+		if ( !script ) {
+			perror(script_name);
+			exit(1);
+		}
+		script_next();
+	}
+
+	next_input = INPUT_PERIOD;
+	next_sof = SOF_PERIOD;
+	script_poll();
+}
+
+void hal_clock_start(void) {
+	clock_origin = now;
+	clock_running = true;
+}
+
+void hal_clock_reset(void) {
+	clock_origin = now - ((now - clock_origin) & 0xFFFF);
+}
+
+void hal_clock_read(uint32_t *count, uint16_t *tcnt) {
+	uint64_t elapsed = clock_running ? now - clock_origin : 0;
+	*count = elapsed >> 16;
+	*tcnt = elapsed & 0xFFFF;
+}
+
+// A fixed sequence rather than the cycle count, so that a run can be
+// repeated exactly.
+uint8_t hal_entropy(void) {
+	entropy = entropy * 1103515245 + 12345;
+	return entropy >> 16;
+}
+
+uint16_t hal_timer(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec * F_CPU + t.tv_nsec / (1000000000 / F_CPU);
+}
+
+uint8_t hal_switches(void) {
+	return switches;
+}
+
+void hal_leds(bool on) {
+	leds_on = on;
+}
+
+void hal_wait(void) {
+	now += PWM_PERIOD;
+	hal_pwm_hook();
+
+	if ( now >= next_input ) {
+		next_input += INPUT_PERIOD;
+		script_poll();
+		hal_input_hook();
+
+		if ( output_pending ) {
+			fflush(stdout);
+			output_pending = false;
+		}
+	}
+
+	if ( now >= next_sof ) {
+		next_sof += SOF_PERIOD;
+		if ( usb_serial_sof_hook ) {
+			usb_serial_sof_hook();
+		}
+	}
+}
+
+/*
+ *	usb_serial.h
+ */
+
+void usb_init(void) {
+}
+
+uint8_t usb_configured(void) {
+	return 1;
+}
+
+int16_t usb_serial_getchar(void) {
+	if ( serial_head != serial_tail ) {
+		return serial_queue[serial_tail++ & (SERIAL_QUEUE_SIZE - 1)];
+	}
+
+	struct pollfd in = { .fd = STDIN_FILENO, .events = POLLIN };
+	uint8_t c;
+	if ( stdin_open && poll(&in, 1, 0) > 0 ) {
+		if ( read(STDIN_FILENO, &c, 1) == 1 ) {
+			return c;
+		}
+		stdin_open = false;
+	}
+	return -1;
+}
+
+uint8_t usb_serial_available(void) {
+	uint16_t count = serial_head - serial_tail;
+	return count > 255 ? 255 : count;
+}
+
+void usb_serial_flush_input(void) {
+	serial_tail = serial_head;
+}
+
+int8_t usb_serial_putchar(uint8_t c) {
+	putchar(c);
+	output_pending = true;
+	return 0;
+}
+
+int8_t usb_serial_putchar_nowait(uint8_t c) {
+	return usb_serial_putchar(c);
+}
+
+int8_t usb_serial_write(const uint8_t *buffer, uint16_t size) {
+	fwrite(buffer, 1, size, stdout);
+	output_pending = true;
+	return 0;
+}
+
+void usb_serial_flush_output(void) {
+	fflush(stdout);
+	output_pending = false;
+}
+
+/*
+ *	cab202_adc.h. Readings come straight from the script: the filters
+ *	only matter for real thumbwheels.
+ */
+
+void adc_init() {
+}
+
+uint16_t adc_read(uint8_t channel) {
+	return channel < ADC_CHANNELS ? adc_values[channel] : 0;
+}
+
+void adc_start(const uint8_t *channels, uint8_t count, uint8_t trigger) {
+}
+
+void adc_stop() {
+}
+
+uint16_t adc_latest(uint8_t channel) {
+	return adc_read(channel);
+}
+
+/*
+ *	ram_utils.h. The host has no AVR memory map to measure, so every
+ *	figure reads zero.
+ */
+
+void ram_usage(ram_usage_t *usage) {
+	usage->heap_top = 0;
+	usage->stack_low = 0;
+	usage->free_gap = 0;
+}
+#endif
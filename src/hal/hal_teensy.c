@@ -0,0 +1,89 @@
+/*
+ *	Tom and Jerry on the Teensy
+ *	hal_teensy.c
+ *
+ *	TeensyPewPew backend for hal.h.
+ */
+#ifndef HAL_HOST
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+#include <cpu_speed.h>
+#include <macros.h>
+
+#include "hal.h"
+
+static volatile uint32_t overflow_count;
+
+void hal_init(void) {
+	set_clock_speed(CPU_8MHz);
+
+	// Joystick - Input
+	CLEAR_BIT(DDRD, 1); // Up
+	CLEAR_BIT(DDRB, 1); // Left
+	CLEAR_BIT(DDRB, 7); // Down
+	CLEAR_BIT(DDRD, 0); // Right
+	CLEAR_BIT(DDRB, 0); // Centre
+
+	// Tactile Buttons - Input
+	CLEAR_BIT(DDRF, 5); // SW1 (Left Button)
+	CLEAR_BIT(DDRF, 6); // SW2 (Right Button)
+
+	// LEDs - Output
+	SET_BIT(DDRB, 2); // Left LED
+	SET_BIT(DDRB, 3); // Right LED
+
+	// Timer 0 (hal_pwm_hook), normal mode, no prescaler: 256 cycles
+	TCCR0A = 0;
+	TCCR0B = 1;
+	TIMSK0 = 1;
+
+	// Timer 1 (hal_input_hook), normal mode, no prescaler: 65536 cycles
+	TCCR1A = 0;
+	TCCR1B = 1;
+	TIMSK1 = 1;
+
+	sei();
+}
+
+void hal_clock_start(void) {
+	// Timer 3 (game clock), normal mode, no prescaler: 65536 cycles
+	TCCR3A = 0;
+	TCCR3B = 1;
+	TIMSK3 = 1;
+}
+
+void hal_clock_reset(void) {
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		overflow_count = 0;
+	}
+}
+
+void hal_clock_read(uint32_t *count, uint16_t *tcnt) {
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		*count = overflow_count;
+		*tcnt = TCNT3;
+		// The counter wrapped but the overflow interrupt has not run yet
+		if ( BIT_IS_SET(TIFR3, TOV3) && *tcnt < 0x8000 ) {
+			(*count)++;
+		}
+	}
+}
+
+uint8_t hal_entropy(void) {
+	return TCNT0;
+}
+
+ISR(TIMER0_OVF_vect) {
+	hal_pwm_hook();
+}
+
+ISR(TIMER1_OVF_vect) {
+	hal_input_hook();
+}
+
+ISR(TIMER3_OVF_vect) {
+	overflow_count++;
+}
+#endif
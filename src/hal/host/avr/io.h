@@ -0,0 +1,18 @@
+/*
+ *	Tom and Jerry on the Teensy
+ *	host/avr/io.h
+ *
+ *	Host stand-in for <avr/io.h>. Only the port registers exist, as plain
+ *	variables defined in hal_host.c, so that library code which sets up
+ *	its pins (lcd_init()) builds unchanged. Nothing reads them back.
+ */
+#ifndef HOST_AVR_IO_H_
+#define HOST_AVR_IO_H_
+
+#include <stdint.h>
+
+extern volatile uint8_t PINB, PINC, PIND, PINE, PINF;
+extern volatile uint8_t DDRB, DDRC, DDRD, DDRE, DDRF;
+extern volatile uint8_t PORTB, PORTC, PORTD, PORTE, PORTF;
+
+#endif /* HOST_AVR_IO_H_ */
@@ -0,0 +1,24 @@
+/*
+ *	Tom and Jerry on the Teensy
+ *	host/avr/pgmspace.h
+ *
+ *	Host stand-in for <avr/pgmspace.h>: there is one address space, so
+ *	flash data is ordinary const data and the _P functions are the plain
+ *	ones.
+ */
+#ifndef HOST_AVR_PGMSPACE_H_
+#define HOST_AVR_PGMSPACE_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s)				(s)
+
+#define pgm_read_byte(p)	(*(const uint8_t *)(p))
+#define pgm_read_word(p)	(*(const uint16_t *)(p))
+#define pgm_read_ptr(p)		(*(void *const *)(p))
+
+#define memcpy_P			memcpy
+
+#endif /* HOST_AVR_PGMSPACE_H_ */
@@ -0,0 +1,16 @@
+/*
+ *	Tom and Jerry on the Teensy
+ *	host/util/atomic.h
+ *
+ *	Host stand-in for <util/atomic.h>. The host backend runs its "interrupt"
+ *	hooks from hal_wait() on the main thread, so nothing can interrupt a
+ *	block and it only has to run once.
+ */
+#ifndef HOST_UTIL_ATOMIC_H_
+#define HOST_UTIL_ATOMIC_H_
+
+#define ATOMIC_BLOCK(type)	for ( int atomic_once_ = 1; atomic_once_; atomic_once_ = 0 )
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_FORCEON
+
+#endif /* HOST_UTIL_ATOMIC_H_ */
@@ -0,0 +1,19 @@
+/*
+ *	Tom and Jerry on the Teensy
+ *	host/util/crc16.h
+ *
+ *	Host stand-in for <util/crc16.h>, using the C equivalents given in the
+ *	avr-libc documentation.
+ */
+#ifndef HOST_UTIL_CRC16_H_
+#define HOST_UTIL_CRC16_H_
+
+#include <stdint.h>
+
+static inline uint16_t _crc_ccitt_update(uint16_t crc, uint8_t data) {
+	data ^= (uint8_t)crc;
+	data ^= data << 4;
+	return ((((uint16_t)data << 8) | (crc >> 8)) ^ (uint8_t)(data >> 4) ^ ((uint16_t)data << 3));
+}
+
+#endif /* HOST_UTIL_CRC16_H_ */
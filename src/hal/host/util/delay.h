@@ -0,0 +1,13 @@
+/*
+ *	Tom and Jerry on the Teensy
+ *	host/util/delay.h
+ *
+ *	Host stand-in for <util/delay.h>. Delays take no simulated time.
+ */
+#ifndef HOST_UTIL_DELAY_H_
+#define HOST_UTIL_DELAY_H_
+
+#define _delay_ms(ms)	((void)(ms))
+#define _delay_us(us)	((void)(us))
+
+#endif /* HOST_UTIL_DELAY_H_ */
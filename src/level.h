@@ -0,0 +1,44 @@
+// Level descriptors, shared by the built-in levels (levels.h, generated from
+// levels/*.txt by tools/levelgen.py) and rooms uploaded over USB.
+//
+// Level text format, one record per line, all numbers in decimal:
+//   T x y            Tom's start position (top-left corner, pixels)
+//   J x y            Jerry's start position
+//   W x1 y1 x2 y2    A wall; any number up to MAX_WALLS
+//   C max ms         Most cheese on screen, and time between spawns
+//   P max ms         Most mousetraps on screen, and time between drops
+//   M ms             Time between milk drops, or 0 for no milk
+#ifndef LEVEL_H_
+#define LEVEL_H_
+
+#include <stdint.h>
+
+// Most walls in one level; each costs 44 bytes of RAM
+#ifndef MAX_WALLS
+#define MAX_WALLS 8
+#endif
+
+// Most cheese or traps a level can allow on screen at once
+#define MAX_CHEESE 5
+#define MAX_TRAPS 5
+
+// Shortest spawn interval a level can ask for, in milliseconds
+#define MIN_INTERVAL 100
+
+struct level
+{
+    uint8_t tom_x, tom_y, jerry_x, jerry_y;
+    uint8_t max_cheese, max_traps;
+    uint16_t cheese_interval, trap_interval, milk_interval;
+    uint8_t num_walls;
+    uint8_t walls[][4]; // x1, y1, x2, y2
+};
+
+// A level with room for MAX_WALLS walls, for levels built in RAM
+union level_buffer
+{
+    struct level level;
+    uint8_t bytes[sizeof(struct level) + MAX_WALLS * 4];
+};
+
+#endif
@@ -0,0 +1,15 @@
+// Generated by tools/levelgen.py from level1.txt, level2.txt; do not edit.
+#ifndef LEVELS_H_
+#define LEVELS_H_
+
+#include <avr/pgmspace.h>
+
+#include "level.h"
+
+const struct level level_1 PROGMEM = {79, 39, 0, 9, 5, 5, 2000, 3000, 0, 4, {{18, 15, 13, 25}, {25, 35, 25, 45}, {45, 10, 60, 10}, {58, 25, 72, 30}}};
+const struct level level_2 PROGMEM = {79, 39, 0, 9, 5, 5, 2000, 3000, 5000, 4, {{24, 15, 13, 13}, {25, 40, 37, 45}, {33, 10, 48, 10}, {58, 25, 58, 30}}};
+
+#define NUM_LEVELS 2
+const struct level *const levels[NUM_LEVELS] PROGMEM = {&level_1, &level_2};
+
+#endif
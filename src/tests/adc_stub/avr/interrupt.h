@@ -0,0 +1,13 @@
+/*
+ *	Tom and Jerry on the Teensy
+ *	tests/adc_stub/avr/interrupt.h
+ *
+ *	Stand-in for <avr/interrupt.h>: an ISR is a plain function, named after
+ *	its vector, that the test calls when a conversion completes.
+ */
+#ifndef ADC_STUB_AVR_INTERRUPT_H_
+#define ADC_STUB_AVR_INTERRUPT_H_
+
+#define ISR(vector)	void vector(void)
+
+#endif /* ADC_STUB_AVR_INTERRUPT_H_ */
@@ -0,0 +1,39 @@
+/*
+ *	Tom and Jerry on the Teensy
+ *	tests/adc_stub/avr/io.h
+ *
+ *	Stand-in for <avr/io.h> that lets test_adc build cab202_adc.c on the
+ *	host. The ADC registers are variables in the test, except ADCSRA: each
+ *	access goes through adc_stub_adcsra(), which finishes a conversion
+ *	started with ADSC, so the driver's busy-waits end.
+ */
+#ifndef ADC_STUB_AVR_IO_H_
+#define ADC_STUB_AVR_IO_H_
+
+#include <stdint.h>
+
+extern volatile uint8_t ADMUX, ADCSRB;
+extern volatile uint16_t ADC;
+
+volatile uint8_t *adc_stub_adcsra(void);
+#define ADCSRA (*adc_stub_adcsra())
+
+// ADCSRA
+#define ADPS0	0
+#define ADPS1	1
+#define ADPS2	2
+#define ADIE	3
+#define ADIF	4
+#define ADATE	5
+#define ADSC	6
+#define ADEN	7
+
+// ADCSRB
+#define ADTS0	0
+#define ADTS1	1
+#define ADTS2	2
+
+// ADMUX
+#define REFS0	6
+
+#endif /* ADC_STUB_AVR_IO_H_ */
@@ -0,0 +1,43 @@
+// Host test support, for the programs in tests/ that "make test" builds and
+// runs. A test is a main() that makes CHECK()s and returns test_exit().
+// Each failed CHECK() prints its location and message and the test carries
+// on, so one run shows every failure.
+#ifndef TEST_H_
+#define TEST_H_
+
+#include <stdio.h>
+
+static int test_checks, test_failures;
+
+#define CHECK(cond, ...)                                          \
+    do                                                            \
+    {                                                             \
+        test_checks++;                                            \
+        if (!(cond))                                              \
+        {                                                         \
+            test_failures++;                                      \
+            fprintf(stderr, "%s:%d: failed: ", __FILE__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__);                         \
+            fprintf(stderr, "\n");                                \
+        }                                                         \
+    } while (0)
+
+// Print a summary and give main()'s exit status
+static inline int test_exit(const char *name)
+{
+    printf("%s: %d checks, %d failed\n", name, test_checks, test_failures);
+    return test_failures ? 1 : 0;
+}
+
+// Library tests still link the host hal (for the port registers lcd.c sets
+// up), which calls the game's interrupt hooks. Tests that link the game get
+// its hooks instead.
+__attribute__((weak)) void hal_pwm_hook(void)
+{
+}
+
+__attribute__((weak)) void hal_input_hook(void)
+{
+}
+
+#endif
@@ -0,0 +1,228 @@
+// Background ADC sampling (cab202_adc.c) against simulated registers; see
+// tests/adc_stub. Each "conversion" returns the level the test has set for
+// the selected channel, so the round robin, the median and IIR filters and
+// the trigger setup can be checked without a board.
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <cab202_adc.h>
+
+#include "test.h"
+
+volatile uint8_t ADMUX, ADCSRB;
+volatile uint16_t ADC;
+volatile uint8_t adcsra;
+
+// Analog level on each of the 64 channel selections
+uint16_t levels[64];
+
+// Channels converted, in order
+uint8_t converted[64];
+int num_converted;
+
+void ADC_vect(void);
+
+uint8_t selected_channel(void)
+{
+    return (ADMUX & 0x1F) | (ADCSRB & 0x20);
+}
+
+void convert(void)
+{
+    uint8_t channel = selected_channel();
+    ADC = levels[channel];
+    if (num_converted < 64)
+    {
+        converted[num_converted++] = channel;
+    }
+}
+
+volatile uint8_t *adc_stub_adcsra(void)
+{
+    // A conversion started by the driver is done by its next look
+    if (adcsra & (1 << ADSC))
+    {
+        convert();
+        adcsra &= ~(1 << ADSC);
+    }
+    return &adcsra;
+}
+
+// The hardware finishes a background conversion and interrupts
+void conversion_complete(void)
+{
+    adc_stub_adcsra();
+    ADC_vect();
+}
+
+// A trigger source fires in auto-trigger mode
+void trigger(void)
+{
+    convert();
+    ADC_vect();
+}
+
+// The filters as documented in cab202_adc.h, for one channel
+struct model
+{
+    uint16_t history[2];
+    uint16_t iir;
+};
+
+void model_seed(struct model *m, uint16_t sample)
+{
+    m->history[0] = m->history[1] = sample;
+    m->iir = sample << ADC_IIR_SHIFT;
+}
+
+uint16_t model_store(struct model *m, uint16_t sample)
+{
+    uint16_t a = m->history[0], b = m->history[1], c = sample;
+    m->history[0] = b;
+    m->history[1] = sample;
+    uint16_t median = a > b ? (b > c ? b : a > c ? c : a) : (a > c ? a : b > c ? c : b);
+    m->iir += median - (m->iir >> ADC_IIR_SHIFT);
+    return m->iir >> ADC_IIR_SHIFT;
+}
+
+void test_read(void)
+{
+    adc_init();
+    CHECK(adcsra == ((1 << ADEN) | (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0)), "adc_init: ADCSRA %02x", adcsra);
+
+    levels[1] = 700;
+    levels[0x25] = 123;
+    ADCSRB = 1 << ADTS1;
+    CHECK(adc_read(1) == 700, "adc_read(1) gave %u", ADC);
+    CHECK(ADMUX == (1 | (1 << REFS0)), "adc_read(1): ADMUX %02x", ADMUX);
+    CHECK(adc_read(0x25) == 123, "adc_read(0x25) gave %u", ADC);
+    CHECK(ADMUX == (5 | (1 << REFS0)) && ADCSRB == (0x20 | (1 << ADTS1)), "adc_read(0x25): ADMUX %02x ADCSRB %02x, trigger bits must survive", ADMUX, ADCSRB);
+    ADCSRB = 0;
+}
+
+void test_continuous(void)
+{
+    const uint8_t channels[] = {0, 1, 4};
+    struct model models[3];
+    uint32_t seed = 1;
+
+    for (int i = 0; i < 3; i++)
+    {
+        levels[channels[i]] = 100 + 300 * i;
+    }
+    adc_init();
+    adc_start(channels, 3, ADC_TRIGGER_CONTINUOUS);
+
+    for (int i = 0; i < 3; i++)
+    {
+        model_seed(&models[i], levels[channels[i]]);
+        CHECK(adc_latest(channels[i]) == levels[channels[i]], "channel %d not seeded: %u", channels[i], adc_latest(channels[i]));
+    }
+    CHECK(adc_latest(2) == 0, "channel 2 is not sampled, but reads %u", adc_latest(2));
+    CHECK((adcsra & ((1 << ADIE) | (1 << ADSC))) == ((1 << ADIE) | (1 << ADSC)) && !(adcsra & (1 << ADATE)), "continuous start: ADCSRA %02x", adcsra);
+
+    // Noisy levels with the odd spike; every conversion must land in its
+    // own channel's filters, in turn
+    num_converted = 0;
+    for (int n = 0; n < 3000; n++)
+    {
+        int slot = n % 3;
+        uint8_t channel = channels[slot];
+        seed = seed * 1103515245 + 12345;
+        uint16_t level = (seed >> 16) % 1024;
+        levels[channel] = level;
+
+        conversion_complete();
+        uint16_t expected = model_store(&models[slot], level);
+        CHECK(adc_latest(channel) == expected, "conversion %d, channel %d: %u, expected %u", n, channel, adc_latest(channel), expected);
+        CHECK(adcsra & (1 << ADSC), "conversion %d: next conversion not started", n);
+    }
+    for (int n = 0; n < num_converted; n++)
+    {
+        CHECK(converted[n] == channels[n % 3], "conversion %d was of channel %d", n, converted[n]);
+    }
+
+    adc_stop();
+    CHECK(!(adcsra & ((1 << ADIE) | (1 << ADSC))), "adc_stop: ADCSRA %02x", adcsra);
+    CHECK(adc_latest(0) == 0, "stopped, but channel 0 reads %u", adc_latest(0));
+}
+
+void test_filters(void)
+{
+    const uint8_t channel = 1;
+
+    levels[channel] = 500;
+    adc_init();
+    adc_start(&channel, 1, ADC_TRIGGER_CONTINUOUS);
+
+    // A single spike, up or down, never gets past the median
+    levels[channel] = 1023;
+    conversion_complete();
+    levels[channel] = 500;
+    conversion_complete();
+    levels[channel] = 0;
+    conversion_complete();
+    levels[channel] = 500;
+    for (int n = 0; n < 3; n++)
+    {
+        conversion_complete();
+        CHECK(adc_latest(channel) == 500, "spike reached the output: %u", adc_latest(channel));
+    }
+
+    // A step comes through after one sample, rises steadily and settles
+    // on the new level exactly
+    levels[channel] = 900;
+    conversion_complete();
+    CHECK(adc_latest(channel) == 500, "step passed the median at once: %u", adc_latest(channel));
+    uint16_t last = 500;
+    for (int n = 0; n < 40; n++)
+    {
+        conversion_complete();
+        uint16_t value = adc_latest(channel);
+        CHECK(value >= last && value <= 900, "step response went from %u to %u", last, value);
+        last = value;
+    }
+    CHECK(last == 900, "step settled at %u", last);
+
+    adc_stop();
+}
+
+void test_triggered(void)
+{
+    const uint8_t channels[] = {0, 1, 4, 5, 6, 7};
+
+    adcsra = 0;
+    ADCSRB = 0;
+    adc_init();
+    adc_start(channels, 6, ADC_TRIGGER_TIMER1_OVF);
+    CHECK((adcsra & ((1 << ADIE) | (1 << ADATE) | (1 << ADSC))) == ((1 << ADIE) | (1 << ADATE)), "triggered start: ADCSRA %02x", adcsra);
+    CHECK((ADCSRB & 7) == ADC_TRIGGER_TIMER1_OVF, "trigger source %d", ADCSRB & 7);
+
+    // Only the first ADC_MAX_CHANNELS are taken
+    CHECK(adc_latest(6) == 0 && adc_latest(7) == 0, "channels past ADC_MAX_CHANNELS are sampled");
+
+    num_converted = 0;
+    for (int n = 0; n < 12; n++)
+    {
+        trigger();
+    }
+    for (int n = 0; n < num_converted; n++)
+    {
+        CHECK(converted[n] == channels[n % ADC_MAX_CHANNELS], "triggered conversion %d was of channel %d", n, converted[n]);
+    }
+    CHECK(!(adcsra & (1 << ADSC)), "triggered mode started a conversion itself");
+
+    adc_stop();
+    CHECK(!(adcsra & ((1 << ADIE) | (1 << ADATE))), "adc_stop: ADCSRA %02x", adcsra);
+}
+
+int main(void)
+{
+    test_read();
+    test_continuous();
+    test_filters();
+    test_triggered();
+
+    return test_exit("test_adc");
+}
@@ -0,0 +1,185 @@
+// is_wall() and wall_collision(), which test wall segments exactly, cross-
+// checked on random cases against the method they replaced: drawing the
+// walls and probing screen_buffer for lit pixels.
+//
+// The two are not identical, and the checks pin down how they differ:
+//
+// - The segments can touch a box whose pixels the drawn line missed, where
+//   the line crosses between two pixels and only one is lit. These touches
+//   are all within a pixel of a lit pixel.
+// - draw_line() walks steep lines column by column, drawing each column's
+//   rows at once, so it can light a pixel up to half a pixel beside the
+//   segment. The segment then passes within a pixel, horizontally, of the
+//   box the old probe found lit.
+// - Off the screen nothing is drawn, so only the segments see walls there.
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include <graphics.h>
+#include <fixed.h>
+#include <geometry.h>
+#include <macros.h>
+
+#include "test.h"
+#include "../tomjerry.h"
+
+// The old is_pixel(), with the bounds check its callers relied on the
+// buffer layout for
+bool raster_pixel(int x, int y)
+{
+    if (x < 0 || y < 0 || x >= LCD_X || y >= LCD_Y)
+    {
+        return false;
+    }
+    return (screen_buffer[(y >> 3) * LCD_X + x] >> (y & 7)) & 1;
+}
+
+// Whether any pixel of a box is lit
+bool raster_box(int x, int y, int w, int h)
+{
+    for (int i = x; i < x + w; i++)
+    {
+        for (int j = y; j < y + h; j++)
+        {
+            if (raster_pixel(i, j))
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// The old wall_collision(): probe the strip of pixels just outside the edge
+// being moved towards
+bool raster_wall_collision(int x, int y, int dx, int dy)
+{
+    if (dx != 0 && raster_box(dx < 0 ? x + dx : x + OBJ_SIZE, y, 1, OBJ_SIZE))
+    {
+        return true;
+    }
+    if (dy != 0 && raster_box(x, dy > 0 ? y + OBJ_SIZE : y + dy, OBJ_SIZE, 1))
+    {
+        return true;
+    }
+    return false;
+}
+
+bool is_wall_box(int x, int y, int w, int h)
+{
+    return is_wall(FIX_INT(x), FIX_INT(y), FIX_INT(w), FIX_INT(h));
+}
+
+int any_steep_wall(void)
+{
+    for (int i = 0; i < num_walls; i++)
+    {
+        if (ABS(walls[i].y2 - walls[i].y1) > ABS(walls[i].x2 - walls[i].x1))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+long cases, agreed, segment_only, raster_only, off_screen;
+
+// Compare the two for one box, and check that any difference is one of
+// the two kinds described at the top
+void cross_check(int x, int y, int w, int h)
+{
+    bool segment = is_wall_box(x, y, w, h);
+    bool raster = raster_box(x, y, w, h);
+
+    cases++;
+    if (segment == raster)
+    {
+        agreed++;
+    }
+    else if (x + w <= 0 || y + h <= 0 || x >= LCD_X || y >= LCD_Y)
+    {
+        off_screen++;
+    }
+    else if (segment)
+    {
+        segment_only++;
+        CHECK(raster_box(x - 1, y - 1, w + 2, h + 2), "box (%d, %d) %dx%d: segment touch more than a pixel from the line", x, y, w, h);
+    }
+    else
+    {
+        raster_only++;
+        CHECK(any_steep_wall() && is_wall_box(x - 1, y, w + 2, h), "box (%d, %d) %dx%d: lit pixel more than a pixel from the segment", x, y, w, h);
+    }
+}
+
+// The box sizes the game asks about: a firework's pixel, the strips
+// wall_collision() tests, and a whole character
+const int box_w[4] = {1, 1, OBJ_SIZE, OBJ_SIZE};
+const int box_h[4] = {1, OBJ_SIZE, 1, OBJ_SIZE};
+
+int main(void)
+{
+    srand(10);
+
+    // One random wall at a time, with boxes all over and around the screen
+    for (int t = 0; t < 20000; t++)
+    {
+        num_walls = 1;
+        set_wall(&walls[0], rand() % LCD_X, rand() % LCD_Y, rand() % LCD_X, rand() % LCD_Y);
+        clear_screen();
+        draw_walls();
+
+        for (int k = 0; k < 50; k++)
+        {
+            cross_check(rand() % (LCD_X + 6) - 6, rand() % (LCD_Y + 6) - 6, box_w[k & 3], box_h[k & 3]);
+        }
+    }
+    printf("single walls: %ld of %ld boxes agree, %ld touched only by the segment, %ld only by the line\n", agreed, cases, segment_only, raster_only);
+
+    // The built-in levels, moved about, with Tom or Jerry stepping in each
+    // direction: wall_collision() must agree with the old probe, or differ
+    // on a strip in one of the ways above
+    long moves = 0, moves_agreed = 0;
+    off_screen = 0;
+    for (int t = 0; t < 4000; t++)
+    {
+        current_level = 1 + t % 2;
+        load_current_level();
+        int ox = rand() % 41 - 20, oy = rand() % 21 - 10;
+        for (int i = 0; i < num_walls; i++)
+        {
+            struct wall *w = &walls[i];
+            set_wall(w, fix_trunc(w->x1) + ox, fix_trunc(w->y1) + oy, fix_trunc(w->x2) + ox, fix_trunc(w->y2) + oy);
+        }
+        clear_screen();
+        draw_walls();
+
+        for (int k = 0; k < 50; k++)
+        {
+            struct player p = {0};
+            int x = rand() % (LCD_X - OBJ_SIZE + 1), y = rand() % (LCD_Y - OBJ_SIZE + 1);
+            int dx = rand() % 3 - 1, dy = rand() % 3 - 1;
+            p.x = FIX_INT(x);
+            p.y = FIX_INT(y);
+
+            moves++;
+            if (wall_collision(p, dx, dy) == raster_wall_collision(x, y, dx, dy))
+            {
+                moves_agreed++;
+                continue;
+            }
+            if (dx != 0)
+            {
+                cross_check(dx < 0 ? x + dx : x + OBJ_SIZE, y, 1, OBJ_SIZE);
+            }
+            if (dy != 0)
+            {
+                cross_check(x, dy > 0 ? y + OBJ_SIZE : y + dy, OBJ_SIZE, 1);
+            }
+        }
+    }
+    printf("level walls: %ld of %ld moves agree, %ld strips differ off the screen\n", moves_agreed, moves, off_screen);
+
+    return test_exit("test_collision");
+}
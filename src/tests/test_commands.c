@@ -0,0 +1,359 @@
+// Fuzz tests for serial input: the byte ring between the input hook and
+// the main loop, then the command decoder and room upload parser behind it.
+//
+// The ring is checked against a simple queue model, one operation at a
+// time, and then with a producer thread racing the consumer. Room uploads
+// are generated line by line, good and bad, and must be committed exactly
+// when every line is good. Random bytes, commands and room data mixed,
+// must leave the game and the uploaded room in a valid state.
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include <graphics.h>
+#include <fixed.h>
+#include <ring.h>
+
+#include "test.h"
+#include "../tomjerry.h"
+
+// From levels.h
+#define NUM_LEVELS 2
+
+/*
+ *  The ring on its own
+ */
+
+void fuzz_ring_model(void)
+{
+    static uint8_t buffers[7][128];
+    for (int size_log = 1; size_log <= 7; size_log++)
+    {
+        uint8_t *buffer = buffers[size_log - 1];
+        int size = 1 << size_log;
+        ring_t ring = {buffer, size - 1, 0, 0};
+
+        // The model: a queue that never wraps
+        uint8_t model[200000];
+        int model_head = 0, model_tail = 0;
+        uint8_t next = 0;
+
+        for (int i = 0; i < 100000; i++)
+        {
+            int op = rand() % 8;
+            int count = model_head - model_tail;
+            uint8_t byte;
+
+            if (op < 4)
+            {
+                uint8_t put = ring_put(&ring, next);
+                CHECK(put == (count < size), "size %d: put with %d waiting returned %d", size, count, put);
+                if (put)
+                {
+                    model[model_head++] = next;
+                }
+                next++;
+            }
+            else if (op < 6)
+            {
+                uint8_t got = ring_get(&ring, &byte);
+                CHECK(got == (count > 0), "size %d: get with %d waiting returned %d", size, count, got);
+                if (got)
+                {
+                    CHECK(byte == model[model_tail], "size %d: got %d, expected %d", size, byte, model[model_tail]);
+                    model_tail++;
+                }
+            }
+            else if (op == 6)
+            {
+                uint8_t peeked = ring_peek(&ring, &byte);
+                CHECK(peeked == (count > 0), "size %d: peek with %d waiting returned %d", size, count, peeked);
+                if (peeked)
+                {
+                    CHECK(byte == model[model_tail], "size %d: peeked %d, expected %d", size, byte, model[model_tail]);
+                    if (rand() & 1)
+                    {
+                        ring_skip(&ring);
+                        model_tail++;
+                    }
+                }
+            }
+            else if (rand() % 50 == 0)
+            {
+                ring_flush(&ring);
+                model_tail = model_head;
+            }
+
+            count = model_head - model_tail;
+            CHECK(ring_count(&ring) == count && ring_free(&ring) == size - count, "size %d: count %d free %d, model has %d", size, ring_count(&ring), ring_free(&ring), count);
+        }
+    }
+}
+
+// A producer thread puts a counting sequence as fast as the ring takes it.
+// Each side yields when it has to wait, so that a single CPU still makes
+// progress.
+#define THREAD_BYTES 1000000
+
+uint8_t thread_buffer[16];
+ring_t thread_ring = RING_INIT(thread_buffer);
+
+void *producer(void *arg)
+{
+    for (uint32_t i = 0; i < THREAD_BYTES;)
+    {
+        if (ring_put(&thread_ring, (uint8_t)(i * 7)))
+        {
+            i++;
+        }
+        else
+        {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+void fuzz_ring_threads(void)
+{
+    pthread_t thread;
+    pthread_create(&thread, NULL, producer, NULL);
+
+    uint32_t errors = 0;
+    for (uint32_t i = 0; i < THREAD_BYTES;)
+    {
+        uint8_t byte;
+        if ((i & 1) ? ring_get(&thread_ring, &byte) : (ring_peek(&thread_ring, &byte) && (ring_skip(&thread_ring), 1)))
+        {
+            errors += byte != (uint8_t)(i * 7);
+            i++;
+        }
+        else
+        {
+            sched_yield();
+        }
+    }
+    pthread_join(thread, NULL);
+    CHECK(errors == 0, "%u of %u bytes out of order between threads", errors, THREAD_BYTES);
+}
+
+/*
+ *  Serial input through the game
+ */
+
+// Queue bytes for the main loop as the input hook does, a random number at
+// a time, running process_commands() whenever the ring fills or a chunk
+// ends
+void feed(const char *text, int length)
+{
+    for (int i = 0; i < length;)
+    {
+        int chunk = 1 + rand() % 40;
+        while (chunk-- > 0 && i < length && ring_put(&usb_rx, text[i]))
+        {
+            i++;
+        }
+        process_commands();
+
+        // 'l' on the last level ends the game, and input then waits for
+        // the game over screen; start again as that screen would
+        if (game_over)
+        {
+            game_over = false;
+            current_level = 1;
+            setup_vars();
+        }
+    }
+    process_commands();
+}
+
+// Room upload lines, made good or bad at random. Returns whether the line
+// is good; *room is updated as a good line would update it.
+bool room_line(char *line, struct level *room)
+{
+    const char *space = (const char *[]){" ", "  ", "\t"}[rand() % 3];
+    const char *end = rand() % 4 ? "\n" : "\r\n";
+    int kind = rand() % 6;
+    int a = rand() % 100, b = rand() % 60, c = rand() % 100, d = rand() % 60;
+    bool good;
+
+    if (rand() % 10 == 0)
+    {
+        // Malformed: a letter among the numbers, a field short, a field
+        // too many, or a number too big for 16 bits
+        const char *bad[] = {"T 1x 20", "J 10", "W 1 20 3 20 5", "C 2 70000", "P 1 2 3", "M x"};
+        sprintf(line, "%s%s", bad[rand() % 6], end);
+        return false;
+    }
+
+    switch (kind)
+    {
+    case 0:
+    case 1:
+        good = a + OBJ_SIZE <= LCD_X && b > STATUS_BAR_HEIGHT && b + OBJ_SIZE <= LCD_Y;
+        sprintf(line, "%c%s%d%s%d%s", kind ? 'J' : 'T', space, a, space, b, end);
+        if (good && kind)
+        {
+            room->jerry_x = a;
+            room->jerry_y = b;
+        }
+        else if (good)
+        {
+            room->tom_x = a;
+            room->tom_y = b;
+        }
+        return good;
+
+    case 2:
+    case 3:
+        a = rand() % 7;
+        b = rand() % 400;
+        good = a >= 1 && a <= MAX_CHEESE && b >= MIN_INTERVAL;
+        sprintf(line, "%c%s%d%s%d%s", kind == 2 ? 'C' : 'P', space, a, space, b, end);
+        if (good && kind == 2)
+        {
+            room->max_cheese = a;
+            room->cheese_interval = b;
+        }
+        else if (good)
+        {
+            room->max_traps = a;
+            room->trap_interval = b;
+        }
+        return good;
+
+    case 4:
+        a = rand() % 3 ? rand() % 400 : 0;
+        good = a == 0 || a >= MIN_INTERVAL;
+        sprintf(line, "M%s%d%s", space, a, end);
+        if (good)
+        {
+            room->milk_interval = a;
+        }
+        return good;
+    }
+
+    good = a < LCD_X && c < LCD_X && b >= STATUS_BAR_HEIGHT && b < LCD_Y && d >= STATUS_BAR_HEIGHT && d < LCD_Y && room->num_walls < MAX_WALLS;
+    sprintf(line, "W%s%d%s%d%s%d%s%d%s", space, a, space, b, space, c, space, d, end);
+    if (good)
+    {
+        uint8_t *w = room->walls[room->num_walls++];
+        w[0] = a;
+        w[1] = b;
+        w[2] = c;
+        w[3] = d;
+    }
+    return good;
+}
+
+int uploads_loaded, uploads_rejected;
+
+void fuzz_uploads(void)
+{
+    for (int t = 0; t < 20000; t++)
+    {
+        union level_buffer expected = {0};
+        memcpy(&expected.level, builtin_level(UPLOAD_LEVEL), sizeof(struct level));
+        expected.level.num_walls = 0;
+        union level_buffer before = uploaded_room;
+        bool was_uploaded = room_uploaded;
+
+        char text[2048];
+        int length = 0;
+        bool good = true;
+        int lines = 1 + rand() % 12;
+        for (int i = 0; i < lines; i++)
+        {
+            // Mostly good lines, so that whole uploads often are
+            bool line_good;
+            char line[64];
+            do
+            {
+                line_good = room_line(line, &expected.level);
+            } while (!line_good && rand() % 8 != 0);
+            good = good && line_good;
+            length += sprintf(text + length, "%s", line);
+        }
+        length += sprintf(text + length, "\n");
+        feed(text, length);
+
+        if (good)
+        {
+            uploads_loaded++;
+            CHECK(room_uploaded, "upload %d: good room not loaded", t);
+            CHECK(memcmp(&uploaded_room, &expected, sizeof(expected)) == 0, "upload %d: room differs from the upload", t);
+        }
+        else
+        {
+            uploads_rejected++;
+            CHECK(room_uploaded == was_uploaded && memcmp(&uploaded_room, &before, sizeof(before)) == 0, "upload %d: bad room changed the uploaded room", t);
+        }
+    }
+}
+
+// Whether an uploaded room is one the parser could have accepted
+bool room_valid(const struct level *room)
+{
+    bool ok = room->num_walls <= MAX_WALLS;
+    ok = ok && room->tom_x + OBJ_SIZE <= LCD_X && room->tom_y > STATUS_BAR_HEIGHT && room->tom_y + OBJ_SIZE <= LCD_Y;
+    ok = ok && room->jerry_x + OBJ_SIZE <= LCD_X && room->jerry_y > STATUS_BAR_HEIGHT && room->jerry_y + OBJ_SIZE <= LCD_Y;
+    ok = ok && room->max_cheese >= 1 && room->max_cheese <= MAX_CHEESE && room->cheese_interval >= MIN_INTERVAL;
+    ok = ok && room->max_traps >= 1 && room->max_traps <= MAX_TRAPS && room->trap_interval >= MIN_INTERVAL;
+    ok = ok && (room->milk_interval == 0 || room->milk_interval >= MIN_INTERVAL);
+    for (int i = 0; ok && i < room->num_walls; i++)
+    {
+        const uint8_t *w = room->walls[i];
+        ok = w[0] < LCD_X && w[2] < LCD_X && w[1] >= STATUS_BAR_HEIGHT && w[1] < LCD_Y && w[3] >= STATUS_BAR_HEIGHT && w[3] < LCD_Y;
+    }
+    return ok;
+}
+
+// Random bytes, weighted towards the ones that mean something
+void fuzz_bytes(void)
+{
+    const char alphabet[] = "TJWCPMwasdplft0123456789  \t\r\n\n";
+    for (int t = 0; t < 20000; t++)
+    {
+        char text[256];
+        int length = 1 + rand() % sizeof(text);
+        for (int i = 0; i < length; i++)
+        {
+            text[i] = rand() % 4 ? alphabet[rand() % (sizeof(alphabet) - 1)] : rand();
+        }
+        feed(text, length);
+
+        CHECK(current_level >= 1 && current_level <= NUM_LEVELS, "batch %d: level %d", t, current_level);
+        CHECK(jerry.x >= 0 && jerry.x + FIX_INT(OBJ_SIZE) <= FIX_INT(LCD_X) && jerry.y > FIX_INT(STATUS_BAR_HEIGHT) && jerry.y + FIX_INT(OBJ_SIZE) <= FIX_INT(LCD_Y), "batch %d: Jerry at (%d, %d)", t, fix_trunc(jerry.x), fix_trunc(jerry.y));
+        CHECK(!room_uploaded || room_valid(&uploaded_room.level), "batch %d: invalid room loaded", t);
+    }
+}
+
+int main(void)
+{
+    srand(14);
+
+    fuzz_ring_model();
+    fuzz_ring_threads();
+
+    // The game replies on stdout; keep it out of the test output
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    int null = open("/dev/null", O_WRONLY);
+    dup2(null, STDOUT_FILENO);
+
+    setup_vars();
+    room_parser_reset(&room_parser);
+    fuzz_uploads();
+    fuzz_bytes();
+
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    printf("uploads: %d loaded, %d rejected\n", uploads_loaded, uploads_rejected);
+
+    return test_exit("test_commands");
+}
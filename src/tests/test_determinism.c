@@ -0,0 +1,200 @@
+// The fixed-step main loop on the simulated clock: the same input trace
+// gives the same game, step for step, every time it is played; and when
+// frames overrun, renders are dropped but every step still runs, unless a
+// stall leaves the game too far behind to catch up.
+//
+// Each run is a child process playing tests/trace_replay.txt through
+// run_frame() with telemetry on, so that its output is the state record of
+// every step. An overloaded run spends another STEP_CYCLES * 3 / 2 cycles
+// after each pass through the loop, as if render() took that long. A stalled
+// run plays normally but for one pass, halfway through, that takes
+// STALL_STEPS steps' time: the screen must be drawn again within
+// MAX_CATCHUP_STEPS + 1 steps, with the rest of the steps due skipped.
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <hal.h>
+#include <graphics.h>
+
+#include "test.h"
+#include "../tomjerry.h"
+
+// Forty seconds, all on level 1 of the trace
+#define RUN_CYCLES (40 * 8000000UL)
+
+#define OVERLOAD_WAITS (STEP_CYCLES * 3 / 2 / 256)
+
+#define STALL_STEPS 200
+#define STALL_WAITS (STEP_CYCLES * STALL_STEPS / 256)
+
+enum load
+{
+    NORMAL,
+    OVERLOADED,
+    STALLED,
+};
+
+// What a run reports: its scheduler counters, how many steps were due but
+// not yet run when it stopped, and in a stalled run, how many steps ran after
+// the stall before the next render
+struct result
+{
+    struct frame_timing timing;
+    int32_t behind;
+    uint32_t steps_to_render;
+};
+
+// Play the trace in a child process with its output in file
+struct result run(const char *file, enum load load)
+{
+    int fds[2];
+    struct result result = {0};
+    if (pipe(fds) != 0)
+    {
+        perror("pipe");
+        exit(1);
+    }
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(fds[0]);
+        if (!freopen(file, "wb", stdout))
+        {
+            perror(file);
+            _exit(1);
+        }
+
+        // setup() without the start screen
+        setenv("HAL_SCRIPT", "tests/trace_replay.txt", 1);
+        hal_init();
+        lcd_init(LCD_DEFAULT_CONTRAST);
+        setup_vars();
+        hal_clock_start();
+        telemetry_on = true;
+
+        bool stalled = false;
+        next_step = clock_cycles();
+        while (clock_cycles() < RUN_CYCLES)
+        {
+            run_frame();
+            for (int i = 0; load == OVERLOADED && i < OVERLOAD_WAITS; i++)
+            {
+                hal_wait();
+            }
+
+            if (load == STALLED && !stalled && clock_cycles() >= RUN_CYCLES / 2)
+            {
+                for (int i = 0; i < STALL_WAITS; i++)
+                {
+                    hal_wait();
+                }
+                stalled = true;
+
+                uint32_t steps = timing.steps, frames = timing.frames;
+                while (timing.frames == frames && timing.steps - steps <= STALL_STEPS)
+                {
+                    run_frame();
+                }
+                result.steps_to_render = timing.steps - steps;
+            }
+        }
+
+        fflush(stdout);
+        result.timing = timing;
+        int32_t late = clock_cycles() - next_step;
+        result.behind = late < 0 ? 0 : late / STEP_CYCLES + 1;
+        if (write(fds[1], &result, sizeof(result)) != sizeof(result))
+        {
+            _exit(1);
+        }
+        _exit(0);
+    }
+
+    close(fds[1]);
+    int status;
+    bool read_ok = read(fds[0], &result, sizeof(result)) == sizeof(result);
+    close(fds[0]);
+    waitpid(pid, &status, 0);
+    CHECK(read_ok && WIFEXITED(status) && WEXITSTATUS(status) == 0, "run into %s failed", file);
+    return result;
+}
+
+// Whether two files have the same contents; sets *size to the first's size
+bool same_file(const char *a, const char *b, long *size)
+{
+    FILE *fa = fopen(a, "rb"), *fb = fopen(b, "rb");
+    bool same = fa && fb;
+    *size = 0;
+    while (same)
+    {
+        int ca = getc(fa), cb = getc(fb);
+        same = ca == cb;
+        if (ca == EOF)
+        {
+            break;
+        }
+        (*size)++;
+    }
+    if (fa)
+    {
+        fclose(fa);
+    }
+    if (fb)
+    {
+        fclose(fb);
+    }
+    return same;
+}
+
+int main(void)
+{
+    char files[5][32];
+    for (int i = 0; i < 5; i++)
+    {
+        snprintf(files[i], sizeof(files[i]), "/tmp/test_determinism.%d.%d", (int)getpid(), i);
+    }
+
+    struct result normal = run(files[0], NORMAL);
+    struct result normal_again = run(files[1], NORMAL);
+    struct result overloaded = run(files[2], OVERLOADED);
+    struct result overloaded_again = run(files[3], OVERLOADED);
+    struct result stalled = run(files[4], STALLED);
+
+    // Every step that fell due ran, or is at most the overrun behind
+    CHECK(normal.behind == 0, "normal run stopped %d steps behind", normal.behind);
+    CHECK(overloaded.behind <= 2, "overloaded run stopped %d steps behind", overloaded.behind);
+    CHECK(normal.timing.steps >= RUN_CYCLES / STEP_CYCLES, "normal run: %u steps in %lu cycles", normal.timing.steps, RUN_CYCLES);
+    CHECK(overloaded.timing.steps + overloaded.behind >= RUN_CYCLES / STEP_CYCLES, "overloaded run: %u steps in %lu cycles", overloaded.timing.steps, RUN_CYCLES);
+
+    // Only renders give way
+    CHECK(normal.timing.skipped == 0 && overloaded.timing.skipped == 0, "steps skipped: %u normal, %u overloaded", normal.timing.skipped, overloaded.timing.skipped);
+    CHECK(normal.timing.dropped == 0 && normal.timing.frames == normal.timing.steps, "normal run: %u frames, %u dropped for %u steps", normal.timing.frames, normal.timing.dropped, normal.timing.steps);
+    CHECK(overloaded.timing.dropped > 0 && overloaded.timing.frames + overloaded.timing.dropped <= overloaded.timing.steps, "overloaded run: %u frames, %u dropped for %u steps", overloaded.timing.frames, overloaded.timing.dropped, overloaded.timing.steps);
+
+    // The same inputs at the same times give the same game
+    long size;
+    CHECK(same_file(files[0], files[1], &size), "two normal runs differ after %ld bytes of state", size);
+    CHECK(size > 0, "no state records");
+    CHECK(same_file(files[2], files[3], &size), "two overloaded runs differ after %ld bytes of state", size);
+    CHECK(memcmp(&normal.timing, &normal_again.timing, 3 * sizeof(uint32_t)) == 0 && memcmp(&overloaded.timing, &overloaded_again.timing, 3 * sizeof(uint32_t)) == 0, "scheduler counters differ between repeated runs");
+
+    // A stall is drawn over after a few steps, and the steps it leaves too
+    // far behind are given up, not run later
+    CHECK(stalled.steps_to_render > 0 && stalled.steps_to_render <= MAX_CATCHUP_STEPS + 1, "stalled run: %u steps before the next render", stalled.steps_to_render);
+    CHECK(stalled.timing.skipped >= STALL_STEPS - MAX_CATCHUP_STEPS - 1 && stalled.timing.skipped <= STALL_STEPS, "stalled run: %u steps skipped for a stall of %d", stalled.timing.skipped, STALL_STEPS);
+    CHECK(stalled.behind == 0 && stalled.timing.steps + stalled.timing.skipped >= RUN_CYCLES / STEP_CYCLES, "stalled run: %u steps and %u skipped in %lu cycles", stalled.timing.steps, stalled.timing.skipped, RUN_CYCLES);
+
+    printf("normal: %u steps, %u frames; overloaded: %u steps, %u frames, %u renders dropped; stalled: %u steps skipped, render after %u; %ld bytes of state\n", normal.timing.steps, normal.timing.frames, overloaded.timing.steps, overloaded.timing.frames, overloaded.timing.dropped, stalled.timing.skipped, stalled.steps_to_render, size);
+
+    for (int i = 0; i < 5; i++)
+    {
+        remove(files[i]);
+    }
+    return test_exit("test_determinism");
+}
@@ -0,0 +1,114 @@
+// draw_char() against the pixel-at-a-time version it replaced: the same
+// pixels for every glyph, colour and position (clipped or not), then a
+// benchmark of both on the game's status bar text.
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include <avr/pgmspace.h>
+#include <graphics.h>
+
+#include "test.h"
+
+// The previous draw_char(), one draw_pixel() per pixel of the 5x8 cell
+void draw_char_pixels(int top_left_x, int top_left_y, char character, colour_t colour)
+{
+    for (uint8_t i = 0; i < CHAR_WIDTH; i++)
+    {
+        uint8_t pixel_data = pgm_read_byte(&(ASCII[character - 0x20][i]));
+
+        if (colour == BG_COLOUR)
+        {
+            pixel_data = ~pixel_data;
+        }
+
+        for (uint8_t j = 0; j < CHAR_HEIGHT; j++)
+        {
+            draw_pixel(top_left_x + i, top_left_y + j, (pixel_data & (1 << j)) >> j);
+        }
+    }
+}
+
+void draw_string_pixels(int top_left_x, int top_left_y, char *text, colour_t colour)
+{
+    for (uint8_t x = top_left_x, i = 0; text[i] != 0; x += CHAR_WIDTH, i++)
+    {
+        draw_char_pixels(x, top_left_y, text[i], colour);
+    }
+}
+
+double now_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+// The four status bar fields draw_gui() draws every frame
+char *hud[4] = {"L:2", "H:5", "S:12", "01:23"};
+int hud_x[4] = {0, 18, 36, 55};
+
+void draw_hud(void (*draw)(int, int, char *, colour_t))
+{
+    for (int i = 0; i < 4; i++)
+    {
+        draw(hud_x[i], 0, hud[i], FG_COLOUR);
+    }
+}
+
+#define FRAMES 200000
+
+int main(void)
+{
+    uint8_t expected[LCD_BUFFER_SIZE];
+
+    // Every glyph, both colours, every position from fully off the top
+    // left to fully off the bottom right. The background is a pattern so
+    // that pixels the glyph must leave alone are checked too.
+    int placements = 0, mismatches = 0;
+    for (int c = 0x20; c < 0x80; c++)
+    {
+        for (int colour = BG_COLOUR; colour <= FG_COLOUR; colour++)
+        {
+            for (int y = -CHAR_HEIGHT; y <= LCD_Y; y++)
+            {
+                for (int x = -CHAR_WIDTH; x <= LCD_X; x++)
+                {
+                    memset(screen_buffer, 0x5A, LCD_BUFFER_SIZE);
+                    draw_char_pixels(x, y, c, colour);
+                    memcpy(expected, screen_buffer, LCD_BUFFER_SIZE);
+
+                    memset(screen_buffer, 0x5A, LCD_BUFFER_SIZE);
+                    draw_char(x, y, c, colour);
+                    placements++;
+
+                    if (memcmp(expected, screen_buffer, LCD_BUFFER_SIZE) != 0 && mismatches++ < 10)
+                    {
+                        CHECK(false, "'%c' colour %d at (%d, %d) differs", c, colour, x, y);
+                    }
+                }
+            }
+        }
+    }
+    CHECK(mismatches == 0, "%d of %d glyph placements differ", mismatches, placements);
+
+    // Benchmark: the status bar, drawn each way
+    double start = now_ns();
+    for (int i = 0; i < FRAMES; i++)
+    {
+        draw_hud(draw_string_pixels);
+    }
+    double pixels_ns = (now_ns() - start) / FRAMES;
+
+    start = now_ns();
+    for (int i = 0; i < FRAMES; i++)
+    {
+        draw_hud(draw_string);
+    }
+    double bytes_ns = (now_ns() - start) / FRAMES;
+
+    printf("status bar: %.0f ns per frame pixel by pixel, %.0f ns with column bytes (%.1fx)\n", pixels_ns, bytes_ns, pixels_ns / bytes_ns);
+
+    return test_exit("test_draw_char");
+}
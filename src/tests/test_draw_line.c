@@ -0,0 +1,227 @@
+// Golden-image test for draw_line(): the integer version against the float
+// version it replaced, for every line shape that fits on the screen.
+//
+// The two agree except where the float version's error term should reach
+// exactly 1/2. Both step to the next row when the error reaches 1/2, but
+// the float sum of dy/dx, which is inexact, can land a rounding step below
+// 1/2 instead. The old code then steps one column late; the integer error
+// term is exact and steps on time. The test replays the float error term
+// for each shape to find these ties, and checks that a line differs
+// exactly when its shape has one, starting where the tie is.
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <graphics.h>
+#include <macros.h>
+
+#include "test.h"
+
+// The previous draw_line(), with the diagonal case in float
+void draw_line_float(int x1, int y1, int x2, int y2, colour_t colour)
+{
+    if (x1 == x2)
+    {
+        for (int i = y1; (y2 > y1) ? i <= y2 : i >= y2; (y2 > y1) ? i++ : i--)
+        {
+            draw_pixel(x1, i, colour);
+        }
+    }
+    else if (y1 == y2)
+    {
+        for (int i = x1; (x2 > x1) ? i <= x2 : i >= x2; (x2 > x1) ? i++ : i--)
+        {
+            draw_pixel(i, y1, colour);
+        }
+    }
+    else
+    {
+        if (x1 > x2)
+        {
+            int t = x1;
+            x1 = x2;
+            x2 = t;
+            t = y1;
+            y1 = y2;
+            y2 = t;
+        }
+
+        float dx = x2 - x1;
+        float dy = y2 - y1;
+        float err = 0.0;
+        float derr = ABS(dy / dx);
+
+        for (int x = x1, y = y1; (dx > 0) ? x <= x2 : x >= x2; (dx > 0) ? x++ : x--)
+        {
+            draw_pixel(x, y, colour);
+            err += derr;
+            while (err >= 0.5 && ((dy > 0) ? y <= y2 : y >= y2))
+            {
+                draw_pixel(x, y, colour);
+                y += (dy > 0) - (dy < 0);
+                err -= 1.0;
+            }
+        }
+    }
+}
+
+// Run both error terms of a dx by dy line (dx, dy > 0) side by side. Returns
+// the first column where the exact error is 1/2 and the float one is below
+// it, storing the float value in *below, or -1 if there is none. Any other
+// disagreement between the two is returned as -2.
+int float_tie_column(int dx, int dy, float *below)
+{
+    float err_float = 0;
+    float derr_float = (float)dy / (float)dx;
+    int32_t err = 0; // Exact error, scaled by 2 * dx
+
+    for (int x = 0, y = 0; x <= dx; x++)
+    {
+        err_float += derr_float;
+        err += 2 * dy;
+        while (y <= dy)
+        {
+            bool step = err >= dx;
+            bool step_float = err_float >= 0.5;
+            if (err == dx && !step_float)
+            {
+                *below = err_float;
+                return x;
+            }
+            if (step != step_float)
+            {
+                return -2;
+            }
+            if (!step)
+            {
+                break;
+            }
+            y++;
+            err -= 2 * dx;
+            err_float -= 1.0;
+        }
+    }
+    return -1;
+}
+
+uint8_t expected[LCD_BUFFER_SIZE];
+
+// Draw a line both ways; returns whether they differ
+bool lines_differ(int x1, int y1, int x2, int y2, colour_t colour)
+{
+    memset(screen_buffer, colour ? 0 : 0xFF, LCD_BUFFER_SIZE);
+    draw_line_float(x1, y1, x2, y2, colour);
+    memcpy(expected, screen_buffer, LCD_BUFFER_SIZE);
+
+    memset(screen_buffer, colour ? 0 : 0xFF, LCD_BUFFER_SIZE);
+    draw_line(x1, y1, x2, y2, colour);
+    return memcmp(expected, screen_buffer, LCD_BUFFER_SIZE) != 0;
+}
+
+// Leftmost column where the last two lines drawn by lines_differ()
+// differ, or -1
+int first_difference(void)
+{
+    for (int x = 0; x < LCD_X; x++)
+    {
+        for (int bank = 0; bank < LCD_BANKS; bank++)
+        {
+            if (expected[bank * LCD_X + x] != screen_buffer[bank * LCD_X + x])
+            {
+                return x;
+            }
+        }
+    }
+    return -1;
+}
+
+int main(void)
+{
+    // Horizontal and vertical lines, including clipped ones, match exactly
+    for (int a = -3; a < LCD_X + 3; a++)
+    {
+        for (int b = -3; b < LCD_X + 3; b++)
+        {
+            for (int c = -2; c < LCD_Y + 2; c += 3)
+            {
+                CHECK(!lines_differ(a, c, b, c, FG_COLOUR), "horizontal (%d, %d)-(%d, %d) differs", a, c, b, c);
+                CHECK(!lines_differ(a, c, b, c, BG_COLOUR), "erased horizontal (%d, %d)-(%d, %d) differs", a, c, b, c);
+            }
+        }
+    }
+    for (int a = -3; a < LCD_Y + 3; a++)
+    {
+        for (int b = -3; b < LCD_Y + 3; b++)
+        {
+            for (int c = -2; c < LCD_X + 2; c += 3)
+            {
+                CHECK(!lines_differ(c, a, c, b, FG_COLOUR), "vertical (%d, %d)-(%d, %d) differs", c, a, c, b);
+                CHECK(!lines_differ(c, a, c, b, BG_COLOUR), "erased vertical (%d, %d)-(%d, %d) differs", c, a, c, b);
+            }
+        }
+    }
+
+    // Every diagonal shape that fits on the screen, in all four
+    // orientations. A shape must differ exactly when the float error term
+    // falls short of a tie, from the tie's column on.
+    int differing = 0;
+    for (int dx = 1; dx < LCD_X; dx++)
+    {
+        for (int dy = 1; dy < LCD_Y; dy++)
+        {
+            float below = 0;
+            int column = float_tie_column(dx, dy, &below);
+            CHECK(column != -2, "shape %d x %d: float and exact error terms disagree away from a tie", dx, dy);
+
+            int x = (LCD_X - 1 - dx) / 2;
+            int y = (LCD_Y - 1 - dy) / 2;
+            const int ends[4][4] = {
+                {x, y, x + dx, y + dy},
+                {x + dx, y + dy, x, y},
+                {x, y + dy, x + dx, y},
+                {x + dx, y, x, y + dy},
+            };
+            for (int i = 0; i < 4; i++)
+            {
+                bool differ = lines_differ(ends[i][0], ends[i][1], ends[i][2], ends[i][3], FG_COLOUR);
+                CHECK(differ == (column >= 0), "shape %d x %d, orientation %d: %s", dx, dy, i, differ ? "differs without a float tie" : "matches despite a float tie");
+                // The late step shows in the tie's column if the line had
+                // already stepped there, or else in the next column
+                int first = first_difference() - x;
+                if (differ && column >= 0)
+                {
+                    CHECK(first == column || first == column + 1, "shape %d x %d, orientation %d: first differs at column %d, tie at %d", dx, dy, i, first, column);
+                }
+            }
+            if (column >= 0)
+            {
+                CHECK(below < 0.5, "shape %d x %d: float error %.8f is not below 1/2", dx, dy, below);
+                differing++;
+            }
+        }
+    }
+    printf("%d of %d diagonal shapes differ, all at float ties\n", differing, (LCD_X - 1) * (LCD_Y - 1));
+
+    // Random lines, mostly clipped and some longer than the screen, for
+    // which there is no list: any difference must have the same cause.
+    srand(5);
+    int random_differing = 0;
+    for (int i = 0; i < 200000; i++)
+    {
+        int x1 = rand() % 200 - 58, y1 = rand() % 140 - 46;
+        int x2 = rand() % 200 - 58, y2 = rand() % 140 - 46;
+        if (x1 == x2 || y1 == y2 || !lines_differ(x1, y1, x2, y2, FG_COLOUR))
+        {
+            continue;
+        }
+        random_differing++;
+
+        float below;
+        int column = float_tie_column(ABS(x2 - x1), ABS(y2 - y1), &below);
+        CHECK(column >= 0, "(%d, %d)-(%d, %d) differs without a float tie", x1, y1, x2, y2);
+    }
+    printf("%d of 200000 random lines differ, all at float ties\n", random_differing);
+
+    return test_exit("test_draw_line");
+}
@@ -0,0 +1,165 @@
+// Accuracy of the fixed-point trigonometry and square roots against libm,
+// over every input the game can give them, then a host microbenchmark of
+// each against the libm call it replaced. Cycle counts on the AVR itself
+// come from the benchmark firmware (make bench).
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <time.h>
+
+#include <fixed.h>
+
+#include "test.h"
+
+#define D(a) FIX_TO_DOUBLE(a)
+
+struct error
+{
+    double max, total;
+    long count;
+};
+
+void add_error(struct error *e, double error)
+{
+    error = fabs(error);
+    e->max = fmax(e->max, error);
+    e->total += error;
+    e->count++;
+}
+
+void report(const char *name, const struct error *e)
+{
+    printf("%-14s max %.6f  mean %.6f  (%ld inputs)\n", name, e->max, e->total / e->count, e->count);
+}
+
+double now_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+// Keeps benchmark results alive
+volatile double sink_double;
+volatile fixed_t sink_fixed;
+
+#define RUNS 2000000
+
+int main(void)
+{
+    // Sine and cosine of every binary angle
+    struct error sin_error = {0}, cos_error = {0};
+    for (int a = 0; a < ANGLE_TURN; a++)
+    {
+        double radians = a * (2 * M_PI / ANGLE_TURN);
+        add_error(&sin_error, D(fix_sin(a)) - sin(radians));
+        add_error(&cos_error, D(fix_cos(a)) - cos(radians));
+    }
+    report("fix_sin", &sin_error);
+    report("fix_cos", &cos_error);
+    CHECK(sin_error.max <= 1.0 / 512, "fix_sin is out by %f", sin_error.max);
+    CHECK(cos_error.max <= 1.0 / 512, "fix_cos is out by %f", cos_error.max);
+
+    // Square roots: every value up to 128.0, then a sweep to the limit
+    struct error sqrt_error = {0};
+    for (fixed_t a = 0; a < (1L << 23); a += a < FIX_INT(128) ? 1 : 97)
+    {
+        fixed_t root = fix_sqrt(a);
+        double exact = sqrt(D(a));
+        add_error(&sqrt_error, D(root) - exact);
+        CHECK(D(root) <= exact && exact < D(root + 1), "fix_sqrt(%f) = %f, not %f rounded down", D(a), D(root), exact);
+    }
+    report("fix_sqrt", &sqrt_error);
+
+    // Unit vectors: every wall shape, and sub-pixel vectors in every
+    // direction from 1/256 to 90 pixels long (fireworks aiming at Tom)
+    struct error normalize_error = {0}, length_error = {0};
+    for (int y = -47; y <= 47; y++)
+    {
+        for (int x = -83; x <= 83; x++)
+        {
+            fixed_t nx = FIX_INT(x), ny = FIX_INT(y);
+            CHECK(fix_normalize(&nx, &ny) == (x != 0 || y != 0), "(%d, %d) normalized wrongly", x, y);
+            if (x != 0 || y != 0)
+            {
+                double length = hypot(x, y);
+                add_error(&normalize_error, D(nx) - x / length);
+                add_error(&normalize_error, D(ny) - y / length);
+                add_error(&length_error, hypot(D(nx), D(ny)) - 1);
+            }
+        }
+    }
+    for (int a = 0; a < 4096; a++)
+    {
+        for (double length = 1.0 / FIX_ONE; length < 90; length *= 1.05)
+        {
+            fixed_t x = lround(cos(a * (2 * M_PI / 4096)) * length * FIX_ONE);
+            fixed_t y = lround(sin(a * (2 * M_PI / 4096)) * length * FIX_ONE);
+            fixed_t nx = x, ny = y;
+            if (!fix_normalize(&nx, &ny))
+            {
+                CHECK(x == 0 && y == 0, "(%f, %f) has no direction", D(x), D(y));
+                continue;
+            }
+            double exact = hypot(x, y);
+            add_error(&normalize_error, D(nx) - x / exact);
+            add_error(&normalize_error, D(ny) - y / exact);
+            add_error(&length_error, hypot(D(nx), D(ny)) - 1);
+        }
+    }
+    report("fix_normalize", &normalize_error);
+    report("  (length)", &length_error);
+    CHECK(normalize_error.max <= 1.0 / 512 + 1.0 / 16384, "fix_normalize is out by %f", normalize_error.max);
+
+    // Benchmark. The host has an FPU, so the AVR's soft-float costs do not
+    // show here; this only keeps an eye on the fixed-point versions.
+    double start = now_ns();
+    for (long i = 0; i < RUNS; i++)
+    {
+        sink_double = sin((i & 255) * (2 * M_PI / ANGLE_TURN));
+    }
+    double sin_ns = (now_ns() - start) / RUNS;
+
+    start = now_ns();
+    for (long i = 0; i < RUNS; i++)
+    {
+        sink_fixed = fix_sin(i);
+    }
+    double fix_sin_ns = (now_ns() - start) / RUNS;
+
+    start = now_ns();
+    for (long i = 0; i < RUNS; i++)
+    {
+        sink_double = sqrt((double)(i & 0xFFFFF));
+    }
+    double sqrt_ns = (now_ns() - start) / RUNS;
+
+    start = now_ns();
+    for (long i = 0; i < RUNS; i++)
+    {
+        sink_fixed = fix_sqrt(i & 0xFFFFF);
+    }
+    double fix_sqrt_ns = (now_ns() - start) / RUNS;
+
+    start = now_ns();
+    for (long i = 0; i < RUNS; i++)
+    {
+        double x = (i & 0xFFF) - 2048, y = 1000 - (i & 0x7FF);
+        double d = sqrt(x * x + y * y);
+        sink_double = x * (1 / d) + y * (1 / d);
+    }
+    double unit_ns = (now_ns() - start) / RUNS;
+
+    start = now_ns();
+    for (long i = 0; i < RUNS; i++)
+    {
+        fixed_t x = (i & 0xFFF) - 2048, y = 1000 - (i & 0x7FF);
+        fix_normalize(&x, &y);
+        sink_fixed = x + y;
+    }
+    double fix_unit_ns = (now_ns() - start) / RUNS;
+
+    printf("host ns per call: sin %.1f, fix_sin %.1f; sqrt %.1f, fix_sqrt %.1f; unit vector %.1f, fix_normalize %.1f\n", sin_ns, fix_sin_ns, sqrt_ns, fix_sqrt_ns, unit_ns, fix_unit_ns);
+
+    return test_exit("test_fixed");
+}
@@ -0,0 +1,81 @@
+// The fmt_* functions against snprintf(): the same text when it fits, and
+// when it does not, the same text cut off at the end of the buffer, with
+// nothing written past it.
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <avr/pgmspace.h>
+#include <format.h>
+
+#include "test.h"
+
+#define GUARD 0xA5
+
+// Run a format into buffers of every size up to one that fits, each with
+// guard bytes after its end, and compare with the expected text
+#define CHECK_FORMAT(expected, call)                                                        \
+    do                                                                                      \
+    {                                                                                       \
+        const char *want = (expected);                                                      \
+        int length = strlen(want);                                                          \
+        for (int size = 1; size <= length + 1; size++)                                      \
+        {                                                                                   \
+            char buffer[64];                                                                \
+            memset(buffer, GUARD, sizeof(buffer));                                          \
+            char *start = buffer, *end = buffer + size;                                     \
+            char *p = call;                                                                 \
+            int cut = size - 1 < length ? size - 1 : length;                                \
+            CHECK(p == buffer + cut && strlen(buffer) == (size_t)cut && strncmp(buffer, want, cut) == 0, \
+                  "%s in %d bytes gave \"%s\", expected \"%.*s\"", #call, size, buffer, cut, want); \
+            CHECK((uint8_t)buffer[size] == GUARD, "%s in %d bytes wrote past the end", #call, size); \
+        }                                                                                   \
+    } while (0)
+
+int main(void)
+{
+    char expected[64];
+
+    CHECK_FORMAT("", fmt_str(start, end, ""));
+    CHECK_FORMAT("Score: ", fmt_str(start, end, "Score: "));
+    CHECK_FORMAT("Game Time: ", fmt_str_P(start, end, PSTR("Game Time: ")));
+
+    const uint32_t uints[] = {0, 7, 10, 65535, 65536, 99999, 1000000, 4294967295u};
+    for (int i = 0; i < 8; i++)
+    {
+        for (int width = 0; width <= 12; width += 3)
+        {
+            snprintf(expected, sizeof(expected), "%0*u", width, uints[i]);
+            CHECK_FORMAT(expected, fmt_uint(start, end, uints[i], width));
+        }
+    }
+
+    const int32_t ints[] = {0, -1, 42, -32768, 2147483647, -2147483647 - 1};
+    for (int i = 0; i < 6; i++)
+    {
+        snprintf(expected, sizeof(expected), "%d", ints[i]);
+        CHECK_FORMAT(expected, fmt_int(start, end, ints[i]));
+    }
+
+    const uint32_t seconds[] = {0, 59, 61, 5999, 6000, 4294967295u};
+    for (int i = 0; i < 6; i++)
+    {
+        snprintf(expected, sizeof(expected), "%02u:%02u", seconds[i] / 60, seconds[i] % 60);
+        CHECK_FORMAT(expected, fmt_mmss(start, end, seconds[i]));
+    }
+
+    // Chained calls stop at the end of the buffer together
+    snprintf(expected, sizeof(expected), "\rSteps: %u Frames: %u\n", 4294967295u, 123456u);
+    CHECK_FORMAT(expected, fmt_str_P(fmt_uint(fmt_str_P(fmt_uint(fmt_str_P(start, end, PSTR("\rSteps: ")), end, 4294967295u, 0), end, PSTR(" Frames: ")), end, 123456, 0), end, PSTR("\n")));
+
+    // Random values
+    srand(18);
+    for (int i = 0; i < 10000; i++)
+    {
+        int32_t value = (int32_t)(((uint32_t)rand() << 16) ^ (uint32_t)rand());
+        snprintf(expected, sizeof(expected), "%d", value);
+        CHECK_FORMAT(expected, fmt_int(start, end, value));
+    }
+
+    return test_exit("test_format");
+}
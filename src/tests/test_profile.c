@@ -0,0 +1,184 @@
+// The phase profiler (profile.h, profile.c) on a scripted timer: each
+// PROF_TIMER() reading is the next value in a script, so the counts every
+// block adds are known exactly. Checks the runs, min, avg and max that
+// prof_report() prints, the stop at UINT16_MAX runs, blocks that span the
+// 16-bit timer wrapping, and the empty slots after a report.
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <avr/pgmspace.h>
+
+// The profiler is tested whatever PROFILE the build sets
+#undef PROFILE
+#define PROFILE 1
+#define PROF_TIMER() fake_timer()
+
+uint16_t fake_timer(void);
+
+#include <profile.h>
+
+#include "test.h"
+
+enum
+{
+    SLOT_STEP,
+    SLOT_RENDER,
+    SLOT_IDLE,
+    NUM_SLOTS
+};
+
+prof_slot_t prof_slots[NUM_SLOTS];
+
+const char slot_step[] PROGMEM = "step";
+const char slot_render[] PROGMEM = "render";
+const char slot_idle[] PROGMEM = "idle";
+
+const char *const slot_names[NUM_SLOTS] PROGMEM = {
+    slot_step,
+    slot_render,
+    slot_idle,
+};
+
+// The timer readings still to come
+const uint16_t *script;
+
+uint16_t fake_timer(void)
+{
+    return *script++;
+}
+
+// One block in slot id, with the timer reading begin then end
+void block(uint8_t id, uint16_t begin, uint16_t end)
+{
+    const uint16_t readings[] = {begin, end};
+    script = readings;
+    PROF_BEGIN(id);
+    PROF_END(id);
+    CHECK(script == readings + 2, "block read the timer %d times", (int)(script - readings));
+}
+
+// One report line as prof_report() sends it
+struct line
+{
+    char name[16];
+    unsigned runs, min, avg, max;
+};
+
+struct line lines[NUM_SLOTS + 1];
+int num_lines;
+
+void collect(const char *start, const char *end)
+{
+    char text[64];
+    int length = end - start;
+    CHECK(length > 0 && length < (int)sizeof(text), "report line of %d bytes", length);
+    if (num_lines > NUM_SLOTS || length <= 0 || length >= (int)sizeof(text))
+    {
+        return;
+    }
+    memcpy(text, start, length);
+    text[length] = 0;
+
+    struct line *l = &lines[num_lines++];
+    int fields = sscanf(text, "\r%15s %u %u %u %u\n", l->name, &l->runs, &l->min, &l->avg, &l->max);
+    CHECK(fields == 5 && text[length - 1] == '\n', "report line \"%s\"", text);
+}
+
+void report(void)
+{
+    num_lines = 0;
+    memset(lines, 0, sizeof(lines));
+    prof_report(NUM_SLOTS, slot_names, collect);
+    CHECK(num_lines == NUM_SLOTS, "report of %d lines", num_lines);
+}
+
+#define CHECK_LINE(id, want_name, want_runs, want_min, want_avg, want_max)                     \
+    CHECK(strcmp(lines[id].name, want_name) == 0 && lines[id].runs == (want_runs) &&         \
+              lines[id].min == (want_min) && lines[id].avg == (want_avg) && lines[id].max == (want_max), \
+          "%s: \"%s %u %u %u %u\", expected \"%s %u %u %u %u\"", #id, lines[id].name, lines[id].runs, \
+          lines[id].min, lines[id].avg, lines[id].max, want_name, want_runs, want_min, want_avg, want_max)
+
+void test_counts(void)
+{
+    // 10, 40, 100 and 250 ticks, in no order: avg 100
+    block(SLOT_STEP, 1000, 1100);
+    block(SLOT_STEP, 5, 45);
+    block(SLOT_STEP, 30000, 30250);
+    block(SLOT_STEP, 7, 17);
+
+    // A single run of no ticks is a minimum of 0
+    block(SLOT_IDLE, 123, 123);
+
+    report();
+    CHECK_LINE(SLOT_STEP, "step", 4u, 10u, 100u, 250u);
+    CHECK_LINE(SLOT_RENDER, "render", 0u, 0u, 0u, 0u);
+    CHECK_LINE(SLOT_IDLE, "idle", 1u, 0u, 0u, 0u);
+}
+
+void test_cap(void)
+{
+    // The longest block, as often as a slot counts: the total just fits
+    for (uint32_t i = 0; i < UINT16_MAX; i++)
+    {
+        block(SLOT_RENDER, 1, 0);
+    }
+    CHECK(prof_slots[SLOT_RENDER].total == (uint32_t)UINT16_MAX * UINT16_MAX, "total %u after %u runs of 65535", prof_slots[SLOT_RENDER].total, UINT16_MAX);
+
+    // Past the cap, runs are not counted at all
+    block(SLOT_RENDER, 0, 1);
+    block(SLOT_RENDER, 0, 0);
+
+    report();
+    CHECK_LINE(SLOT_RENDER, "render", 65535u, 65535u, 65535u, 65535u);
+}
+
+void test_wrap(void)
+{
+    // The timer wraps from 65535 to 0 inside these blocks
+    block(SLOT_STEP, 65500, 100);
+    block(SLOT_STEP, 65535, 0);
+    block(SLOT_STEP, 1, 0);
+
+    report();
+    CHECK_LINE(SLOT_STEP, "step", 3u, 1u, 21890u, 65535u);
+}
+
+void test_reset(void)
+{
+    block(SLOT_STEP, 0, 500);
+    block(SLOT_RENDER, 0, 700);
+    block(SLOT_IDLE, 0, 900);
+    report();
+
+    for (int id = 0; id < NUM_SLOTS; id++)
+    {
+        prof_slot_t *slot = &prof_slots[id];
+        CHECK(slot->count == 0 && slot->min == 0 && slot->max == 0 && slot->total == 0, "slot %d not emptied by prof_report(): %u %u %u %u", id, slot->count, slot->min, slot->max, slot->total);
+    }
+
+    // The next report covers only what ran since, and its minimum is not
+    // held down by the emptied slot
+    block(SLOT_RENDER, 0, 300);
+    report();
+    CHECK_LINE(SLOT_STEP, "step", 0u, 0u, 0u, 0u);
+    CHECK_LINE(SLOT_RENDER, "render", 1u, 300u, 300u, 300u);
+    CHECK_LINE(SLOT_IDLE, "idle", 0u, 0u, 0u, 0u);
+
+    // prof_reset() on its own empties only the slots it is given
+    block(SLOT_STEP, 0, 10);
+    block(SLOT_IDLE, 0, 20);
+    prof_reset(1);
+    CHECK(prof_slots[SLOT_STEP].count == 0 && prof_slots[SLOT_IDLE].count == 1, "prof_reset(1) left %u and %u runs", prof_slots[SLOT_STEP].count, prof_slots[SLOT_IDLE].count);
+    prof_reset(NUM_SLOTS);
+}
+
+int main(void)
+{
+    test_counts();
+    test_cap();
+    test_wrap();
+    test_reset();
+
+    return test_exit("test_profile");
+}
@@ -0,0 +1,142 @@
+// Upload level2.txt, the sample room, the way a terminal would send it:
+// through the USB receive ring in chunks of random size, with either line
+// ending and each way of ending the upload. Every time, the room must be
+// committed exactly as the file describes it, and played straight away
+// when level 2 is the current level.
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <fixed.h>
+#include <ring.h>
+
+#include "test.h"
+#include "../tomjerry.h"
+
+#define ROOM_FILE "level2.txt"
+
+// The room level2.txt describes, on top of the built-in level 2
+void expected_room(union level_buffer *room)
+{
+    memset(room, 0, sizeof(*room));
+    memcpy(&room->level, builtin_level(UPLOAD_LEVEL), sizeof(struct level));
+    room->level.tom_x = 44;
+    room->level.tom_y = 24;
+    room->level.jerry_x = 10;
+    room->level.jerry_y = 10;
+
+    const uint8_t walls[][4] = {{18, 15, 13, 25}, {34, 40, 80, 10}, {40, 20, 20, 10}, {10, 10, 10, 20}};
+    room->level.num_walls = 4;
+    memcpy(room->level.walls, walls, sizeof(walls));
+}
+
+// Send text through the ring in chunks of 1 to max_chunk bytes, with the
+// main loop emptying the ring between chunks
+void send_chunked(const char *text, int length, int max_chunk)
+{
+    for (int i = 0; i < length;)
+    {
+        int chunk = 1 + rand() % max_chunk;
+        while (chunk-- > 0 && i < length && ring_put(&usb_rx, text[i]))
+        {
+            i++;
+        }
+        process_commands();
+    }
+}
+
+int main(void)
+{
+    FILE *f = fopen(ROOM_FILE, "rb");
+    if (!f)
+    {
+        perror(ROOM_FILE);
+        return 1;
+    }
+    char file[512];
+    int file_length = fread(file, 1, sizeof(file), f);
+    fclose(f);
+
+    union level_buffer expected;
+    expected_room(&expected);
+
+    // Replies go to a file, to check the game reports the room it loaded
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    FILE *replies = tmpfile();
+    dup2(fileno(replies), STDOUT_FILENO);
+
+    srand(19);
+    setup_vars();
+    room_parser_reset(&room_parser);
+
+    // Blank line, NUL, EOT, or the next command
+    const char endings[] = {'\n', 0, 4, 'i'};
+    int uploads = 0;
+
+    for (int t = 0; t < 2000; t++)
+    {
+        // Half of them with CRLF line endings
+        char text[1024];
+        int length = 0;
+        bool crlf = t & 1;
+        for (int i = 0; i < file_length; i++)
+        {
+            if (file[i] == '\r')
+            {
+                continue;
+            }
+            if (file[i] == '\n' && crlf)
+            {
+                text[length++] = '\r';
+            }
+            text[length++] = file[i];
+        }
+        if (text[length - 1] != '\n')
+        {
+            text[length++] = '\n';
+        }
+        int ending = (t >> 1) % 4;
+        text[length++] = endings[ending];
+
+        memset(&uploaded_room, 0, sizeof(uploaded_room));
+        room_uploaded = false;
+        current_level = t % 3 == 0 ? UPLOAD_LEVEL : 1;
+        setup_vars();
+
+        send_chunked(text, length, 1 + t % 64);
+        uploads++;
+
+        CHECK(room_uploaded, "upload %d (chunks up to %d, ending %d, %s): not loaded", t, 1 + t % 64, ending, crlf ? "CRLF" : "LF");
+        CHECK(memcmp(&uploaded_room, &expected, sizeof(expected)) == 0, "upload %d: room differs from " ROOM_FILE, t);
+        if (current_level == UPLOAD_LEVEL)
+        {
+            CHECK(tom.x == FIX_INT(44) && tom.y == FIX_INT(24) && jerry.x == FIX_INT(10) && jerry.y == FIX_INT(10), "upload %d: level 2 not restarted in the new room", t);
+        }
+    }
+
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+
+    // One report per upload ('i' replies are lines too)
+    char line[128];
+    int loaded = 0, other = 0;
+    rewind(replies);
+    while (fgets(line, sizeof(line), replies))
+    {
+        if (strcmp(line, "\rRoom loaded, walls: 4\n") == 0)
+        {
+            loaded++;
+        }
+        else if (strncmp(line, "\rRoom", 5) == 0)
+        {
+            other++;
+        }
+    }
+    fclose(replies);
+    CHECK(loaded == uploads && other == 0, "%d uploads, %d reported loaded and %d otherwise", uploads, loaded, other);
+
+    return test_exit("test_room_upload");
+}
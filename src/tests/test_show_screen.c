@@ -0,0 +1,110 @@
+// show_screen() with dirty tracking: counts the bytes sent to a mock LCD
+// transport for typical changes, and checks that the panel model ends up
+// showing screen_buffer every time.
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <graphics.h>
+#include <lcd_transport.h>
+
+#include "test.h"
+
+// Bytes sent to the LCD by one show_screen()
+uint16_t flush_writes(void)
+{
+    uint16_t before = lcd_mock_count;
+    show_screen();
+    return lcd_mock_count - before;
+}
+
+// Whether the panel shows what is in screen_buffer
+bool panel_matches(void)
+{
+    return memcmp(lcd_mock_ram, screen_buffer, LCD_BUFFER_SIZE) == 0;
+}
+
+// lcd_position() is two commands, then one data byte per column of the span
+#define SPAN_WRITES(columns) (2 + (columns))
+#define FULL_WRITES (LCD_BANKS * SPAN_WRITES(LCD_X))
+
+int main(void)
+{
+    lcd_init(LCD_DEFAULT_CONTRAST);
+
+    // Nothing is known about the panel at start-up, so all of it is sent
+    uint16_t n = flush_writes();
+    CHECK(n == FULL_WRITES, "first frame sent %u writes, expected %u", n, FULL_WRITES);
+    CHECK(panel_matches(), "panel differs after first frame");
+
+    n = flush_writes();
+    CHECK(n == 0, "unchanged frame sent %u writes", n);
+
+    draw_pixel(10, 20, FG_COLOUR);
+    n = flush_writes();
+    CHECK(n == SPAN_WRITES(1), "one pixel sent %u writes", n);
+    CHECK(panel_matches(), "panel differs after one pixel");
+
+    // Setting a pixel that is already set changes nothing
+    draw_pixel(10, 20, FG_COLOUR);
+    n = flush_writes();
+    CHECK(n == 0, "redrawn pixel sent %u writes", n);
+
+    // Two pixels in one bank send the span between them
+    draw_pixel(5, 3, FG_COLOUR);
+    draw_pixel(40, 6, FG_COLOUR);
+    n = flush_writes();
+    CHECK(n == SPAN_WRITES(36), "span 5..40 sent %u writes", n);
+    CHECK(panel_matches(), "panel differs after span");
+
+    // A line in one bank, and one through every bank
+    draw_line(5, 12, 20, 12, FG_COLOUR);
+    n = flush_writes();
+    CHECK(n == SPAN_WRITES(16), "horizontal line sent %u writes", n);
+
+    draw_line(60, 0, 60, LCD_Y - 1, FG_COLOUR);
+    n = flush_writes();
+    CHECK(n == LCD_BANKS * SPAN_WRITES(1), "vertical line sent %u writes", n);
+    CHECK(panel_matches(), "panel differs after lines");
+
+    // A glyph straddling two banks
+    draw_char(30, 28, 'A', FG_COLOUR);
+    n = flush_writes();
+    CHECK(n == 2 * SPAN_WRITES(CHAR_WIDTH), "straddling glyph sent %u writes", n);
+    CHECK(panel_matches(), "panel differs after glyph");
+
+    // Clearing only resends the columns that were lit
+    clear_screen();
+    n = flush_writes();
+    CHECK(n > 0 && n < FULL_WRITES, "clear sent %u writes", n);
+    CHECK(panel_matches(), "panel differs after clear");
+
+    n = flush_writes();
+    CHECK(n == 0, "frame after clear sent %u writes", n);
+
+    invalidate_screen();
+    n = flush_writes();
+    CHECK(n == FULL_WRITES, "invalidated frame sent %u writes", n);
+
+    // Random frames drawn the way the game draws: clear, then redraw
+    srand(1);
+    uint32_t total = 0;
+    for (int frame = 0; frame < 500; frame++)
+    {
+        clear_screen();
+        for (int i = 0; i < 6; i++)
+        {
+            draw_line(rand() % 100 - 8, rand() % 60 - 6, rand() % 100 - 8, rand() % 60 - 6, FG_COLOUR);
+        }
+        draw_pixel(rand() % LCD_X, rand() % LCD_Y, rand() & 1);
+        draw_string(rand() % LCD_X, rand() % LCD_Y, "S:12", FG_COLOUR);
+        n = flush_writes();
+        total += n;
+        CHECK(n <= FULL_WRITES, "frame %d sent %u writes", frame, n);
+        CHECK(panel_matches(), "panel differs after frame %d", frame);
+    }
+    printf("random frames: %u writes per frame on average, %u for a full frame\n", total / 500, FULL_WRITES);
+
+    return test_exit("test_show_screen");
+}
@@ -0,0 +1,325 @@
+// Replays an input trace (tests/trace_replay.txt, or the file given as the
+// argument) through the game and follows the same play with the double
+// arithmetic the fixed-point physics replaced: walls, Tom, Jerry and the
+// fireworks must stay within a pixel of it for the whole run.
+//
+// The reference takes the game's discrete decisions as given: when Tom is
+// sent a new way, when something is reset or blocked, when a firework is
+// shot or burns out. Between those, it moves each object with the old
+// double formulas, so the distances measure the drift of the fixed-point
+// motion alone.
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <hal.h>
+#include <graphics.h>
+#include <fixed.h>
+#include <geometry.h>
+#include <cab202_adc.h>
+
+#include "test.h"
+#include "../tomjerry.h"
+
+// Seventy seconds of play, the length of the trace
+#define STEPS 4300
+
+// Tolerance, in pixels
+#define LIMIT 1.0
+
+#define D(a) FIX_TO_DOUBLE(a)
+
+struct ref_wall
+{
+    double x1, y1, x2, y2;
+} ref_walls[MAX_WALLS];
+
+struct ref_point
+{
+    double x, y;
+    bool live;
+} ref_tom, ref_jerry, ref_fireworks[MAX_FIREWORKS];
+
+double max_wall, max_tom, max_jerry, max_firework;
+int tom_resets, jerry_resets, games = 1;
+
+// Speeds as the old set_speeds() worked them out
+double player_speed_double(void)
+{
+    return (adc_latest(0) / 1024.0) * 2;
+}
+
+double wall_speed_double(void)
+{
+    return ((512.0 - adc_latest(1)) / 512.0) * 2;
+}
+
+void sync_walls(void)
+{
+    for (int i = 0; i < num_walls; i++)
+    {
+        ref_walls[i] = (struct ref_wall){D(walls[i].x1), D(walls[i].y1), D(walls[i].x2), D(walls[i].y2)};
+    }
+}
+
+void sync_point(struct ref_point *r, fixed_t x, fixed_t y)
+{
+    r->x = D(x);
+    r->y = D(y);
+    r->live = true;
+}
+
+void sync_all(void)
+{
+    sync_walls();
+    sync_point(&ref_tom, tom.x, tom.y);
+    sync_point(&ref_jerry, jerry.x, jerry.y);
+    for (int i = 0; i < MAX_FIREWORKS; i++)
+    {
+        sync_point(&ref_fireworks[i], fireworks[i].x, fireworks[i].y);
+        ref_fireworks[i].live = fireworks[i].x != FIX_INT(-1);
+    }
+}
+
+// The old check_wall_wrap() and move_walls(), one wall
+void ref_move_wall(struct ref_wall *w, double speed)
+{
+    double dx = w->x2 - w->x1;
+    double dy = w->y2 - w->y1;
+    if (w->y1 < STATUS_BAR_HEIGHT && w->y2 < STATUS_BAR_HEIGHT)
+    {
+        w->y1 = dy > 0 ? LCD_Y : LCD_Y - dy;
+        w->y2 = dy > 0 ? LCD_Y + dy : LCD_Y;
+    }
+    if (w->y1 > LCD_Y && w->y2 > LCD_Y)
+    {
+        w->y1 = dy > 0 ? STATUS_BAR_HEIGHT - dy : STATUS_BAR_HEIGHT;
+        w->y2 = dy > 0 ? STATUS_BAR_HEIGHT : STATUS_BAR_HEIGHT + dy;
+    }
+    if (w->x1 > LCD_X && w->x2 > LCD_X)
+    {
+        w->x1 = dx > 0 ? 0 - dx : 0;
+        w->x2 = dx > 0 ? 0 : 0 + dx;
+    }
+    if (w->x1 < 0 && w->x2 < 0)
+    {
+        w->x1 = dx > 0 ? LCD_X : LCD_X - dx;
+        w->x2 = dx > 0 ? LCD_X + dx : LCD_X;
+    }
+
+    dx = w->x2 - w->x1;
+    dy = w->y2 - w->y1;
+    double move_x, move_y;
+    if (dy != 0 && dx != 0)
+    {
+        double theta = M_PI - atan(dy / dx);
+        move_x = cos(theta) * speed;
+        move_y = sin(theta) * speed;
+    }
+    else if (dy == 0)
+    {
+        move_x = 0;
+        move_y = speed;
+    }
+    else
+    {
+        move_x = speed;
+        move_y = 0;
+    }
+
+    w->x1 += move_x;
+    w->x2 += move_x;
+    w->y1 += move_y;
+    w->y2 += move_y;
+}
+
+// Distance between two positions of a wall coordinate that wraps with the
+// given period: the wall can wrap a step before or after the reference.
+double wrapped_distance(double a, double b, double period)
+{
+    double d = fabs(a - b);
+    return fmin(d, fabs(d - period));
+}
+
+void check_walls(int n)
+{
+    double speed = 0.05 * wall_speed_double();
+    for (int i = 0; i < num_walls; i++)
+    {
+        struct ref_wall *r = &ref_walls[i];
+        ref_move_wall(r, speed);
+
+        const struct wall *w = &walls[i];
+        double period_x = LCD_X + fabs(r->x2 - r->x1);
+        double period_y = LCD_Y - STATUS_BAR_HEIGHT + fabs(r->y2 - r->y1);
+        double error = fmax(fmax(wrapped_distance(D(w->x1), r->x1, period_x), wrapped_distance(D(w->x2), r->x2, period_x)),
+                            fmax(wrapped_distance(D(w->y1), r->y1, period_y), wrapped_distance(D(w->y2), r->y2, period_y)));
+        max_wall = fmax(max_wall, error);
+        CHECK(error < LIMIT, "step %d: wall %d at (%.2f, %.2f)-(%.2f, %.2f), reference (%.2f, %.2f)-(%.2f, %.2f)", n, i, D(w->x1), D(w->y1), D(w->x2), D(w->y2), r->x1, r->y1, r->x2, r->y2);
+    }
+}
+
+// The old update_enemy(), unless the game sent Tom a new way this step.
+// Returns whether Tom was put back at the start.
+bool check_tom(int n, const struct player *before)
+{
+    double speed = D(tom.speed) * player_speed_double();
+    double angle = tom.direction * (2 * M_PI / ANGLE_TURN);
+    double dx = cos(angle) * speed;
+    double dy = sin(angle) * speed;
+
+    // A new way can come out the same as the old, as rand() is seeded
+    // from 8 bits of entropy each step; then Tom has not moved.
+    bool same_way = tom.direction == before->direction && tom.speed == before->speed;
+    bool stood_still = tom.x == before->x && tom.y == before->y && speed >= 1.0 / FIX_ONE;
+    if (same_way && !stood_still)
+    {
+        if (ref_tom.x + dx < LCD_X - 1 && ref_tom.x + dx > 0)
+        {
+            ref_tom.x += dx;
+        }
+        if (ref_tom.y + dy < LCD_Y - 1 && ref_tom.y + dy > STATUS_BAR_HEIGHT)
+        {
+            ref_tom.y += dy;
+        }
+    }
+
+    double error = fmax(fabs(D(tom.x) - ref_tom.x), fabs(D(tom.y) - ref_tom.y));
+    bool near_start = fabs(D(tom.x - tom.init_x)) < 2 && fabs(D(tom.y - tom.init_y)) < 2;
+    if (error >= LIMIT && near_start)
+    {
+        // Caught, hit by a firework or run over by a wall
+        sync_point(&ref_tom, tom.x, tom.y);
+        tom_resets++;
+        return true;
+    }
+    max_tom = fmax(max_tom, error);
+    CHECK(error < LIMIT, "step %d: Tom at (%.2f, %.2f), reference (%.2f, %.2f)", n, D(tom.x), D(tom.y), ref_tom.x, ref_tom.y);
+    return false;
+}
+
+// Jerry moves a whole player_speed along one axis, or is put back
+void check_jerry(int n, const struct player *before)
+{
+    double speed = player_speed_double();
+    double moved_x = D(jerry.x - before->x);
+    double moved_y = D(jerry.y - before->y);
+
+    // player_speed is within 1/512 of the old value
+    if (moved_x != 0 && fabs(fabs(moved_x) - speed) < 0.01 && moved_y == 0)
+    {
+        ref_jerry.x += moved_x > 0 ? speed : -speed;
+    }
+    else if (moved_y != 0 && fabs(fabs(moved_y) - speed) < 0.01 && moved_x == 0)
+    {
+        ref_jerry.y += moved_y > 0 ? speed : -speed;
+    }
+    else if (moved_x != 0 || moved_y != 0)
+    {
+        // Caught, trapped or run over by a wall, then maybe moved on
+        bool near_start = fabs(D(jerry.x - jerry.init_x)) <= speed && fabs(D(jerry.y - jerry.init_y)) <= speed;
+        CHECK(near_start, "step %d: Jerry jumped to (%.2f, %.2f)", n, D(jerry.x), D(jerry.y));
+        sync_point(&ref_jerry, jerry.x, jerry.y);
+        jerry_resets++;
+    }
+
+    double error = fmax(fabs(D(jerry.x) - ref_jerry.x), fabs(D(jerry.y) - ref_jerry.y));
+    max_jerry = fmax(max_jerry, error);
+    CHECK(error < LIMIT, "step %d: Jerry at (%.2f, %.2f), reference (%.2f, %.2f)", n, D(jerry.x), D(jerry.y), ref_jerry.x, ref_jerry.y);
+}
+
+// The old firework_homing(): one pixel towards Tom. Where Tom was put back
+// during the step, fireworks may have aimed at either place, so they are
+// only followed again from the next step.
+void check_fireworks(int n, const struct firework *before, bool tom_reset)
+{
+    for (int i = 0; i < MAX_FIREWORKS; i++)
+    {
+        struct ref_point *r = &ref_fireworks[i];
+        const struct firework *f = &fireworks[i];
+        bool live = f->x != FIX_INT(-1);
+        bool shot = f->x == jerry.x && f->y == jerry.y && (f->x != before[i].x || f->y != before[i].y);
+
+        if (!live || !r->live || shot || tom_reset)
+        {
+            // Burnt out, or just shot from where Jerry is (perhaps in the
+            // step the last firework in this slot burnt out)
+            sync_point(r, f->x, f->y);
+            r->live = live;
+            continue;
+        }
+
+        if (f->x != before[i].x || f->y != before[i].y)
+        {
+            double t1 = D(tom.x) - r->x;
+            double t2 = D(tom.y) - r->y;
+            double d = sqrt(t1 * t1 + t2 * t2);
+            r->x += t1 * (1 / d);
+            r->y += t2 * (1 / d);
+        }
+
+        double error = fmax(fabs(D(f->x) - r->x), fabs(D(f->y) - r->y));
+        max_firework = fmax(max_firework, error);
+        CHECK(error < LIMIT, "step %d: firework %d at (%.2f, %.2f), reference (%.2f, %.2f)", n, i, D(f->x), D(f->y), r->x, r->y);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    setenv("HAL_SCRIPT", argc > 1 ? argv[1] : "tests/trace_replay.txt", 1);
+    hal_init();
+    lcd_init(LCD_DEFAULT_CONTRAST);
+    setup_vars();
+    hal_clock_start();
+    sync_all();
+
+    // The main loop without render(), which changes nothing that is checked
+    uint32_t next_step = clock_cycles();
+    for (int n = 0; n < STEPS; n++)
+    {
+        // Start again at once, as handle_gameover() does once SW1 is pressed
+        if (game_over)
+        {
+            game_over = false;
+            hal_clock_reset();
+            current_level = 1;
+            setup_vars();
+            sync_all();
+            games++;
+            next_step = clock_cycles();
+        }
+
+        while ((int32_t)(clock_cycles() - next_step) < 0)
+        {
+            hal_wait();
+        }
+
+        struct player tom_before = tom, jerry_before = jerry;
+        struct firework fireworks_before[MAX_FIREWORKS];
+        memcpy(fireworks_before, fireworks, sizeof(fireworks));
+        int level = current_level;
+        bool paused = game_paused;
+
+        step();
+        next_step += STEP_CYCLES;
+
+        if (current_level != level)
+        {
+            sync_all();
+            continue;
+        }
+        if (!paused)
+        {
+            check_walls(n);
+            bool tom_reset = check_tom(n, &tom_before);
+            check_fireworks(n, fireworks_before, tom_reset);
+        }
+        check_jerry(n, &jerry_before);
+    }
+    printf("%d steps, %d games, Tom reset %d times, Jerry %d\n", STEPS, games, tom_resets, jerry_resets);
+    printf("largest error (pixels): walls %.3f, Tom %.3f, Jerry %.3f, fireworks %.3f\n", max_wall, max_tom, max_jerry, max_firework);
+
+    return test_exit("test_trace");
+}
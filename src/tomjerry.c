@@ -1,92 +1,173 @@
 #include <stdint.h>
-#include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
-#include <math.h>
 #include <string.h>
 
-#include <avr/io.h>
-#include <avr/interrupt.h>
-#include <util/delay.h>
-#include <cpu_speed.h>
-
+#include <hal.h>
 #include <graphics.h>
+#include <sprite.h>
+#include <fixed.h>
+#include <geometry.h>
+#include <events.h>
+#include <ring.h>
+#include <debounce.h>
+#include <telemetry.h>
+#include <format.h>
+#include <ram_utils.h>
 #include <macros.h>
 #include "lcd_model.h"
+
+// Phase profiler, timed with hal_timer() so that it also runs on the host
+#define PROF_TIMER() hal_timer()
+#include <profile.h>
+#include <sampler.h>
+#include "levels.h"
 #include <usb_serial.h>
 #include <cab202_adc.h>
+#include "tomjerry.h"
 
 // Contant Vars
-#define STATUS_BAR_HEIGHT 8
-#define NUM_SWITCHES 7
-#define OBJ_SIZE 5
-#define MINSPEED 0.2
+#define MINSPEED FIX(0.2)
 #define MAX_PLR_SPEED 2
 #define MAX_WALL_SPEED 2
 #define MAX_BRIGHTNESS 15
 
-// Jerry Bitmap
-uint8_t jerry_bitmap[OBJ_SIZE][OBJ_SIZE] = {{1, 1, 1, 1, 1}, {1, 0, 0, 0, 1}, {1, 1, 0, 1, 1}, {1, 0, 0, 1, 1}, {1, 1, 1, 1, 1}};
+// Super mode length, in milliseconds of game time
+#define SUPER_DURATION 10000
 
-// Super Jerry Bitmap
-uint8_t super_jerry_bitmap[OBJ_SIZE + 1][OBJ_SIZE + 1] = {{1, 1, 1, 1, 1, 1}, {1, 0, 0, 0, 0, 1}, {1, 1, 1, 0, 1, 1}, {1, 0, 1, 0, 1, 1}, {1, 0, 0, 0, 1, 1}, {1, 1, 1, 1, 1, 1}};
+// Most bytes moved from USB into usb_rx per input hook
+#define USB_RX_BURST 8
 
-// Tom Bitmap
-uint8_t tom_bitmap[OBJ_SIZE][OBJ_SIZE] = {{1, 1, 1, 1, 1}, {1, 0, 0, 0, 1}, {1, 1, 0, 1, 1}, {1, 1, 0, 1, 1}, {1, 1, 1, 1, 1}};
+// Most telemetry bytes moved to USB per 1 ms USB frame
+#define TELEMETRY_BURST 16
 
-// Cheese Bitmap
-uint8_t cheese_bitmap[OBJ_SIZE][OBJ_SIZE] = {{1, 1, 1, 1, 1}, {1, 0, 0, 0, 1}, {1, 0, 1, 1, 1}, {1, 0, 0, 0, 1}, {1, 1, 1, 1, 1}};
+// A room upload ends after this long with no input
+#define ROOM_IDLE_MS 250
 
-// Trap Bitmap
-uint8_t trap_bitmap[OBJ_SIZE][OBJ_SIZE] = {{1, 1, 1, 1, 1}, {1, 0, 1, 0, 1}, {1, 0, 1, 0, 1}, {1, 0, 1, 0, 1}, {1, 1, 1, 1, 1}};
+// Telemetry record types
+#define RECORD_STATE 1
+#define RECORD_SAMPLES 2
 
-// Door Bitmap
-uint8_t door_bitmap[OBJ_SIZE][OBJ_SIZE] = {{1, 1, 1, 1, 1}, {1, 0, 0, 0, 1}, {1, 0, 1, 0, 1}, {1, 0, 0, 0, 1}, {1, 1, 1, 1, 1}};
+// Jerry Sprite
+const sprite_t jerry_sprite PROGMEM = SPRITE(OBJ_SIZE, OBJ_SIZE, 0b11111, 0b10001, 0b11011, 0b10011, 0b11111);
 
-// Milk Bitmap
-uint8_t milk_bitmap[OBJ_SIZE][OBJ_SIZE] = {{1, 1, 1, 1, 1}, {1, 1, 0, 1, 1}, {1, 0, 0, 0, 1}, {1, 1, 0, 1, 1}, {1, 1, 1, 1, 1}};
+// Super Jerry Sprite
+const sprite_t super_jerry_sprite PROGMEM = SPRITE(OBJ_SIZE + 1, OBJ_SIZE + 1, 0b111111, 0b100001, 0b111011, 0b101011, 0b100011, 0b111111);
 
-// Global Vars
-int current_level = 1, cheese, cheese_collected, cheese_time, traps, trap_time, placing_trap, milk_time, placing_milk, milk_placed, super_activated, super_time;
-double game_time, pause_start, pause_end, pause_time;
-int cheese_positions[5][2], trap_positions[5][2], door_position[2], milk_position[2];
-bool pause = false;
-bool game_over = false;
-bool pause_check = false;
-double player_speed = 1;
-double wall_speed = 1;
-struct player
-{
-    int lives, score, fireworks;
-    double init_x, init_y, x, y, speed, direction;
-} tom, jerry;
+// Tom Sprite
+const sprite_t tom_sprite PROGMEM = SPRITE(OBJ_SIZE, OBJ_SIZE, 0b11111, 0b10001, 0b11011, 0b11011, 0b11111);
 
-struct firework
-{
-    double x, y;
-} fireworks[20];
+// Cheese Sprite
+const sprite_t cheese_sprite PROGMEM = SPRITE(OBJ_SIZE, OBJ_SIZE, 0b11111, 0b10001, 0b10111, 0b10001, 0b11111);
 
-struct wall
-{
-    double x1, y1, x2, y2;
-} wall_1, wall_2, wall_3, wall_4, wall_5, wall_6;
+// Trap Sprite
+const sprite_t trap_sprite PROGMEM = SPRITE(OBJ_SIZE, OBJ_SIZE, 0b11111, 0b10101, 0b10101, 0b10101, 0b11111);
 
-volatile uint8_t state_counts[7];
-volatile uint8_t switch_states[7];
-// [SW1, SW2, SWA, SWB, SWC, SWD, SWCENTER]
-volatile uint32_t cycle_count = 0;
+// Door Sprite
+const sprite_t door_sprite PROGMEM = SPRITE(OBJ_SIZE, OBJ_SIZE, 0b11111, 0b10001, 0b10101, 0b10001, 0b11111);
+
+// Milk Sprite
+const sprite_t milk_sprite PROGMEM = SPRITE(OBJ_SIZE, OBJ_SIZE, 0b11111, 0b11011, 0b10001, 0b11011, 0b11111);
+
+// Global Vars
+int current_level = 1, cheese, cheese_collected, traps, placing_trap, placing_milk, milk_placed, super_activated;
+// Timers, in milliseconds from clock_ms()
+uint32_t game_time, pause_start, pause_time;
+int cheese_positions[5][2], trap_positions[5][2], door_position[2], milk_position[2];
+bool game_paused = false;
+bool game_over = false;
+fixed_t player_speed = FIX_ONE;
+fixed_t wall_speed = FIX_ONE;
+struct player tom, jerry;
+struct firework fireworks[MAX_FIREWORKS];
+struct wall walls[MAX_WALLS];
+uint8_t num_walls;
+
+// The level being played; its walls are in walls[]
+struct level level;
+
+// Room uploaded over USB, played in place of UPLOAD_LEVEL once loaded
+union level_buffer uploaded_room;
+bool room_uploaded = false;
+
+// Switches, one bit each (SW1..SWCENTER from hal.h) in debounced samples
+#define SWITCH_DOWN(sw) BIT_IS_SET(debounce_state(&switches), sw)
+#define SWITCH_PRESSED(sw) BIT_IS_SET(switch_presses, sw)
+debouncer_t switches;
+uint8_t switch_presses; // Switches pressed since the previous step
+
+// Stream a state record every step, toggled by 't'
+bool telemetry_on = false;
 volatile uint8_t brightness = MAX_BRIGHTNESS;
 uint8_t brightness_dir = 1;
 volatile uint8_t pwm_counter = 0;
 
+// Serial input: filled by hal_input_hook(), drained by process_commands()
+uint8_t usb_rx_buffer[32];
+ring_t usb_rx = RING_INIT(usb_rx_buffer);
+
+// Scheduler counters; see struct frame_timing
+struct frame_timing timing;
+
+#if PROFILE
+// Phases of step() and render() timed by the profiler, printed by 'o'
+enum phase
+{
+    PHASE_SET_SPEEDS,
+    PHASE_MOVE_WALLS,
+    PHASE_CHECK_WALL_OVERLAP,
+    PHASE_UPDATE_ENEMY,
+    PHASE_UPDATE_FIREWORKS,
+    PHASE_HANDLE_PLAYER,
+    PHASE_PLACE_CHEESE_TRAPS,
+    PHASE_DRAW_WALLS,
+    PHASE_DRAW,
+    PHASE_DRAW_OBJS,
+    PHASE_SWAP_AND_FLUSH,
+    NUM_PHASES
+};
+
+const char phase_set_speeds[] PROGMEM = "set_speeds";
+const char phase_move_walls[] PROGMEM = "move_walls";
+const char phase_check_wall_overlap[] PROGMEM = "check_wall_overlap";
+const char phase_update_enemy[] PROGMEM = "update_enemy";
+const char phase_update_fireworks[] PROGMEM = "update_fireworks";
+const char phase_handle_player[] PROGMEM = "handle_player";
+const char phase_place_cheese_traps[] PROGMEM = "place_cheese_traps";
+const char phase_draw_walls[] PROGMEM = "draw_walls";
+const char phase_draw[] PROGMEM = "draw";
+const char phase_draw_objs[] PROGMEM = "draw_objs";
+const char phase_swap_and_flush[] PROGMEM = "swap_and_flush";
+
+const char *const phase_names[NUM_PHASES] PROGMEM = {
+    phase_set_speeds,
+    phase_move_walls,
+    phase_check_wall_overlap,
+    phase_update_enemy,
+    phase_update_fireworks,
+    phase_handle_player,
+    phase_place_cheese_traps,
+    phase_draw_walls,
+    phase_draw,
+    phase_draw_objs,
+    phase_swap_and_flush,
+};
+
+prof_slot_t prof_slots[NUM_PHASES];
+#endif
+
 // Fucntion Declarations
-bool check_collision(struct player plyr, double dx, double dy);
-double elapsed_time();
+bool check_collision(struct player plyr, fixed_t dx, fixed_t dy);
+uint32_t clock_ms();
+uint32_t game_ms();
+void schedule_cheese();
+void schedule_trap();
+void schedule_milk();
+void spawn_door();
+void end_super();
 void paused();
 void setup();
-void setup_vars();
 void place_cheese_door(char c);
-void shoot_firework();
 
 // FOR DEBUGGING
 void send_str(const char *s)
@@ -106,7 +187,7 @@ void start_screen(void)
     int pressed = 0;
     while (pressed == 0)
     {
-        if (BIT_IS_SET(PINF, 5))
+        if (BIT_IS_SET(hal_switches(), SW1))
         {
             pressed = 1;
         }
@@ -115,6 +196,7 @@ void start_screen(void)
         draw_string(10, 30, "Tom And Jerry", FG_COLOUR);
         draw_string(5, 40, "-On the Teensy-", FG_COLOUR);
         show_screen();
+        hal_wait();
     }
 }
 
@@ -124,104 +206,135 @@ void handle_gameover()
     while (pressed == 0)
     {
         clear_screen();
-        if (BIT_IS_SET(PINF, 5))
+        if (BIT_IS_SET(hal_switches(), SW1))
         {
             pressed = 1;
             game_over = false;
-            cycle_count = 0;
+            hal_clock_reset();
             current_level = 1;
             setup_vars();
         }
         draw_string(LCD_X / 2 - 28, LCD_Y / 3, "-GAME OVER-", FG_COLOUR);
         draw_string(LCD_X / 2 - 33, LCD_Y / 3 + 10, "SW3 to Restart", FG_COLOUR);
         show_screen();
+        hal_wait();
     }
 }
 
-void level1_walls()
+// Place a wall and work out which way it moves: perpendicular to itself,
+// downwards for horizontal walls and rightwards for vertical ones.
+void set_wall(struct wall *w, int x1, int y1, int x2, int y2)
 {
-    wall_1.x1 = 18;
-    wall_1.y1 = 15;
-    wall_1.x2 = 13;
-    wall_1.y2 = 25;
-
-    wall_2.x1 = 25;
-    wall_2.y1 = 35;
-    wall_2.x2 = 25;
-    wall_2.y2 = 45;
+    w->x1 = FIX_INT(x1);
+    w->y1 = FIX_INT(y1);
+    w->x2 = FIX_INT(x2);
+    w->y2 = FIX_INT(y2);
+    segment_bounds(w->x1, w->y1, w->x2, w->y2, &w->bounds);
+    w->frac_x = 0;
+    w->frac_y = 0;
 
-    wall_3.x1 = 45;
-    wall_3.y1 = 10;
-    wall_3.x2 = 60;
-    wall_3.y2 = 10;
+    fixed_t dx = w->x2 - w->x1;
+    fixed_t dy = w->y2 - w->y1;
 
-    wall_4.x1 = 58;
-    wall_4.y1 = 25;
-    wall_4.x2 = 72;
-    wall_4.y2 = 30;
+    if (dy != 0 && dx != 0)
+    {
+        // Angle pi - atan(dy / dx), i.e. (-|dx|, dy * sign(dx)) normalised.
+        w->dir_x = -ABS(dx);
+        w->dir_y = dx > 0 ? dy : -dy;
+        fix_normalize(&w->dir_x, &w->dir_y);
+    }
+    else if (dy == 0)
+    {
+        w->dir_x = 0;
+        w->dir_y = FIX_ONE;
+    }
+    else
+    {
+        w->dir_x = FIX_ONE;
+        w->dir_y = 0;
+    }
 }
 
-void level2_walls()
+// Copy a level into play: the header into level, its walls into walls[],
+// and the start positions. Built-in levels are read from flash.
+void load_level(const struct level *source, bool in_flash)
 {
-    wall_1.x1 = 24;
-    wall_1.y1 = 15;
-    wall_1.x2 = 13;
-    wall_1.y2 = 13;
+    if (in_flash)
+    {
+        memcpy_P(&level, source, sizeof(level));
+    }
+    else
+    {
+        level = *source;
+    }
+
+    num_walls = level.num_walls < MAX_WALLS ? level.num_walls : MAX_WALLS;
+    for (int i = 0; i < num_walls; i++)
+    {
+        uint8_t w[4];
+        if (in_flash)
+        {
+            memcpy_P(w, source->walls[i], 4);
+        }
+        else
+        {
+            memcpy(w, source->walls[i], 4);
+        }
+        set_wall(&walls[i], w[0], w[1], w[2], w[3]);
+    }
 
-    wall_2.x1 = 25;
-    wall_2.y1 = 40;
-    wall_2.x2 = 37;
-    wall_2.y2 = 45;
+    jerry.x = FIX_INT(level.jerry_x);
+    jerry.y = FIX_INT(level.jerry_y);
+    tom.x = FIX_INT(level.tom_x);
+    tom.y = FIX_INT(level.tom_y);
+}
 
-    wall_3.x1 = 33;
-    wall_3.y1 = 10;
-    wall_3.x2 = 48;
-    wall_3.y2 = 10;
+// Built-in level number n, counting from 1, in flash
+const struct level *builtin_level(int n)
+{
+    return pgm_read_ptr(&levels[n - 1]);
+}
 
-    wall_4.x1 = 58;
-    wall_4.y1 = 25;
-    wall_4.x2 = 58;
-    wall_4.y2 = 30;
+void load_current_level(void)
+{
+    if (current_level == UPLOAD_LEVEL && room_uploaded)
+    {
+        load_level(&uploaded_room.level, false);
+    }
+    else
+    {
+        load_level(builtin_level(current_level), true);
+    }
 }
 
-void reset_walls()
+// Move on to the next level, or end the game after the last one
+void next_level(void)
 {
-    struct wall *wall_arr[6] = {&wall_1, &wall_2, &wall_3, &wall_4, &wall_5, &wall_6};
-    for (int i = 0; i < 6; i++)
+    if (current_level < NUM_LEVELS)
+    {
+        current_level++;
+        setup_vars();
+    }
+    else
     {
-        wall_arr[i]->x1 = -1;
-        wall_arr[i]->y1 = -1;
-        wall_arr[i]->x2 = -1;
-        wall_arr[i]->y2 = -1;
+        game_over = true;
     }
 }
 
 void setup_vars(void)
 {
+    load_current_level();
+
     if (current_level == 1)
     {
         jerry.score = 0;
         jerry.lives = 5;
-        jerry.x = 0;
-        jerry.y = STATUS_BAR_HEIGHT + 1;
         jerry.fireworks = 0;
-
-        tom.x = LCD_X - 5;
-        tom.y = LCD_Y - 9;
-        tom.speed = ((double)rand() / (double)RAND_MAX * MINSPEED + MINSPEED) * player_speed;
-        tom.direction = ((double)rand() / (double)RAND_MAX) * M_PI * 2;
-
-        level1_walls();
+        randomize_tom();
     }
     else
     {
-        reset_walls();
-        jerry.x = 0;
-        jerry.y = STATUS_BAR_HEIGHT + 1;
-        jerry.fireworks = 20;
-        tom.x = LCD_X - 5;
-        tom.y = LCD_Y - 9;
-        level2_walls();
+        jerry.fireworks = MAX_FIREWORKS;
     }
 
     jerry.init_x = jerry.x;
@@ -232,11 +345,9 @@ void setup_vars(void)
     tom.init_x = tom.x;
     tom.init_y = tom.y;
 
-    for (int i = 0; i < NUM_SWITCHES; i++)
-    {
-        state_counts[i] = 0b00000000;
-        switch_states[i] = 0b00000000;
-    }
+    // Forget presses made before the level started
+    debounce_take_pressed(&switches);
+    debounce_take_released(&switches);
 
     for (int i = 0; i < 5; i++)
     {
@@ -251,66 +362,37 @@ void setup_vars(void)
     milk_position[1] = -10;
 
     pause_time = 0;
-    cheese_time = elapsed_time();
     cheese = 0;
-    trap_time = elapsed_time();
     traps = 0;
     placing_trap = 0;
-    milk_time = elapsed_time();
     milk_placed = 0;
     placing_milk = 0;
 
-    for (int i = 0; i < 20; i++)
+    events_clear();
+    schedule_cheese();
+    schedule_trap();
+    schedule_milk();
+
+    for (int i = 0; i < MAX_FIREWORKS; i++)
     {
-        fireworks[i].x = -1;
-        fireworks[i].y = -1;
+        fireworks[i].x = FIX_INT(-1);
+        fireworks[i].y = FIX_INT(-1);
     }
 }
 
 void setup(void)
 {
+    // Clock, switches, LEDs and the timers behind the hal hooks
+    hal_init();
+
     // Setup LCD Display
-    set_clock_speed(CPU_8MHz);
     lcd_init(LCD_DEFAULT_CONTRAST);
     lcd_clear();
 
-    // Setup Data Direction Register //
-
-    // Joystick - Input
-    CLEAR_BIT(DDRD, 2); // Up Joystick
-    CLEAR_BIT(DDRB, 2); // Left Joystick
-    CLEAR_BIT(DDRB, 8); // Down Joystick
-    CLEAR_BIT(DDRD, 1); // Right Joystick
-    CLEAR_BIT(DDRB, 1); // Centre Joystick
-
-    // Tactile Buttons - Input
-    CLEAR_BIT(DDRF, 5); // SW2 (Left Button)
-    CLEAR_BIT(DDRF, 6); // SW3 (Right Button)
-
-    // Thumbwheels - Input
+    // Thumbwheels, sampled in the background once per input hook
+    static const uint8_t thumbwheels[] = {0, 1};
     adc_init();
-
-    // LEDs - Output
-    SET_BIT(DDRB, 2); // Left LED
-    SET_BIT(DDRB, 3); // Right LED
-
-    // Setup Timers
-
-    // Timer 0 (debouncer), normal mode, 0.08s overflow
-    TCCR0A = 0;
-    TCCR0B = 1;
-    TIMSK0 = 1; // Enable  overflow interupts for this timer.
-
-    // Timer 1 (usb_serial inputs), normal mode, 0.08s overflow
-    CLEAR_BIT(TCCR1A, WGM10);
-    CLEAR_BIT(TCCR1A, WGM11);
-    CLEAR_BIT(TCCR1B, WGM12);
-    CLEAR_BIT(TCCR1B, WGM13);
-    SET_BIT(TCCR1B, CS10);
-    TIMSK1 = 1; // Enable  overflow interupts for this timer.
-
-    // Enable interupts
-    sei();
+    adc_start(thumbwheels, 2, ADC_TRIGGER_TIMER1_OVF);
 
     // Enable USB Serial
     usb_init();
@@ -324,204 +406,203 @@ void setup(void)
 
     start_screen();
 
-    // Timer 3 (game time), normal mode, 1s overflow
-    TCCR3A = 0;
-    TCCR3B = 1;
-    TIMSK3 = 1; // Enable  overflow interupts for this timer.
+    // Game time starts once play does
+    hal_clock_start();
 }
 
-void send_formatted(char *buffer, int buffer_size, const char *format, ...)
+void send_buffer(const char *start, const char *end)
 {
-    va_list args;
-    va_start(args, format);
-    vsnprintf(buffer, buffer_size, format, args);
-    usb_serial_write((uint8_t *)buffer, strlen(buffer));
+    usb_serial_write((const uint8_t *)start, end - start);
 }
 
-void output_state()
+// Send one "label: value" line; label is in flash
+void send_value(const char *label, int32_t value)
 {
-    char str_buffer[80];
+    char str_buffer[40];
+    char *end = FMT_END(str_buffer);
+    char *p = fmt_str_P(str_buffer, end, PSTR("\r"));
+    p = fmt_str_P(p, end, label);
+    p = fmt_int(p, end, value);
+    p = fmt_str_P(p, end, PSTR("\n"));
+    send_buffer(str_buffer, p);
+}
 
-    int i_minutes = floor(game_time / 60.0);
-    double fl_minutes = game_time / 60.0;
-    double fraction = fl_minutes - floor(fl_minutes);
-    int seconds = 60.0 * fraction;
+// RAM use since reset; see ram_usage()
+void output_memory()
+{
+    ram_usage_t usage;
+    ram_usage(&usage);
+    send_value(PSTR("Heap Top: "), usage.heap_top);
+    send_value(PSTR("Stack Low: "), usage.stack_low);
+    send_value(PSTR("Free RAM: "), usage.free_gap);
+}
 
-    send_formatted(str_buffer, sizeof(str_buffer), "\r\n\rGame Time: %02d:%02d\n", i_minutes, seconds);
-    send_formatted(str_buffer, sizeof(str_buffer), "\rCurrent Level: %d\n", current_level);
-    send_formatted(str_buffer, sizeof(str_buffer), "\rLives: %d\n", jerry.lives);
-    send_formatted(str_buffer, sizeof(str_buffer), "\rScore: %d\n", jerry.score);
-    send_formatted(str_buffer, sizeof(str_buffer), "\rFireworks on Screen: %d\n", jerry.score >= 3 ? 20-jerry.fireworks : 0);
-    send_formatted(str_buffer, sizeof(str_buffer), "\rMoustraps on Screen: %d\n", traps);
-    send_formatted(str_buffer, sizeof(str_buffer), "\rCheese on Screen: %d\n", cheese);
-    send_formatted(str_buffer, sizeof(str_buffer), "\rCheese Collected in Room: %d\n", cheese_collected);
-    send_formatted(str_buffer, sizeof(str_buffer), "\rSuper Mode Active: %d\n", super_activated);
-    send_formatted(str_buffer, sizeof(str_buffer), "\rPaused: %d\r\n", pause);
+void output_state()
+{
+    // Sized for the longest line, the one with three counts
+    char str_buffer[sizeof("\rSteps:  Frames:  Dropped: \n") + 3 * FMT_UINT_DIGITS];
+    char *end = FMT_END(str_buffer);
+    char *p;
+
+    p = fmt_str_P(str_buffer, end, PSTR("\r\n\rGame Time: "));
+    p = fmt_mmss(p, end, game_time / 1000);
+    p = fmt_str_P(p, end, PSTR("\n"));
+    send_buffer(str_buffer, p);
+
+    send_value(PSTR("Current Level: "), current_level);
+    send_value(PSTR("Lives: "), jerry.lives);
+    send_value(PSTR("Score: "), jerry.score);
+    send_value(PSTR("Fireworks on Screen: "), jerry.score >= 3 ? MAX_FIREWORKS - jerry.fireworks : 0);
+    send_value(PSTR("Moustraps on Screen: "), traps);
+    send_value(PSTR("Cheese on Screen: "), cheese);
+    send_value(PSTR("Cheese Collected in Room: "), cheese_collected);
+    send_value(PSTR("Super Mode Active: "), super_activated);
+    send_value(PSTR("Paused: "), game_paused);
+
+    // One line at a time, each starting again at the front of str_buffer
+    p = fmt_str_P(str_buffer, end, PSTR("\rSteps: "));
+    p = fmt_uint(p, end, timing.steps, 0);
+    p = fmt_str_P(p, end, PSTR(" Frames: "));
+    p = fmt_uint(p, end, timing.frames, 0);
+    p = fmt_str_P(p, end, PSTR(" Dropped: "));
+    p = fmt_uint(p, end, timing.dropped, 0);
+    p = fmt_str_P(p, end, PSTR(" Skipped: "));
+    p = fmt_uint(p, end, timing.skipped, 0);
+    p = fmt_str_P(p, end, PSTR("\n"));
+    send_buffer(str_buffer, p);
+
+    p = fmt_str_P(str_buffer, end, PSTR("\rStep Cycles: "));
+    p = fmt_uint(p, end, timing.step_cycles, 0);
+    p = fmt_str_P(p, end, PSTR(" (max "));
+    p = fmt_uint(p, end, timing.step_cycles_max, 0);
+    p = fmt_str_P(p, end, PSTR(")\n"));
+    send_buffer(str_buffer, p);
+
+    p = fmt_str_P(str_buffer, end, PSTR("\rRender Cycles: "));
+    p = fmt_uint(p, end, timing.render_cycles, 0);
+    p = fmt_str_P(p, end, PSTR(" (max "));
+    p = fmt_uint(p, end, timing.render_cycles_max, 0);
+    p = fmt_str_P(p, end, PSTR(")\n"));
+    send_buffer(str_buffer, p);
+
+    p = fmt_str_P(str_buffer, end, PSTR("\rIdle Cycles: "));
+    p = fmt_uint(p, end, timing.idle_cycles, 0);
+    p = fmt_str_P(p, end, PSTR("\r\n"));
+    send_buffer(str_buffer, p);
 }
 
-// Interrupts
-ISR(TIMER0_OVF_vect)
+// Interrupt hooks, called by the hal
+void hal_pwm_hook(void)
 {
     if (super_activated)
     {
-        if (pwm_counter % brightness == 0)
-        {
-            SET_BIT(PORTB, 2);
-            SET_BIT(PORTB, 3);
-        }
-        else
-        {
-            CLEAR_BIT(PORTB, 2);
-            CLEAR_BIT(PORTB, 3);
-        }
+        hal_leds(pwm_counter % brightness == 0);
         pwm_counter++;
     }
     else
     {
-        CLEAR_BIT(PORTB, 2);
-        CLEAR_BIT(PORTB, 3);
+        hal_leds(false);
     }
 }
 
-ISR(TIMER1_OVF_vect)
+void hal_input_hook(void)
 {
-    uint8_t pin_arr_1[NUM_SWITCHES] = {PINF, PINF, PINB, PINB, PIND, PIND, PINB};
-    uint8_t pin_arr_2[NUM_SWITCHES] = {5, 6, 7, 1, 1, 0, 0};
+    debounce_update(&switches, hal_switches());
 
-    for (int i = 0; i < NUM_SWITCHES; i++)
+    // Queue serial input for the main loop; it is acted on in step()
+    for (uint8_t n = 0; n < USB_RX_BURST && ring_free(&usb_rx) > 0; n++)
     {
-        state_counts[i] = state_counts[i] << 1;
-        uint8_t mask = 0b00001111;
-        state_counts[i] &= mask;
-        state_counts[i] |= BIT_IS_SET(pin_arr_1[i], pin_arr_2[i]);
-
-        if (state_counts[i] == mask)
-        {
-            switch_states[i] = 1;
-        }
-        else if (state_counts[i] == 0)
+        int16_t c = usb_serial_getchar();
+        if (c < 0)
         {
-            switch_states[i] = 0;
+            break;
         }
+        ring_put(&usb_rx, c);
     }
+}
 
-    int16_t c = usb_serial_getchar();
+// CPU cycles since the game clock started, wrapping every ~9 minutes. Differences
+// between two readings are valid across the wrap.
+uint32_t clock_cycles()
+{
+    uint32_t count;
+    uint16_t tcnt;
+    hal_clock_read(&count, &tcnt);
+    return (count << 16) | tcnt;
+}
 
-    // Down
-    if (c == 's' && jerry.y + OBJ_SIZE + 1 < LCD_Y && !check_collision(jerry, 0, 1))
-    {
-        jerry.y++;
-    }
-    // Left
-    else if (c == 'a' && jerry.x - 1 > 0 && !check_collision(jerry, -1, 0))
-    {
-        jerry.x--;
-    }
-    // Up
-    else if (c == 'w' && jerry.y - 1 > STATUS_BAR_HEIGHT && !check_collision(jerry, 0, -1))
-    {
-        jerry.y--;
-    } // Right
-    else if (c == 'd' && jerry.x + 1 + OBJ_SIZE < LCD_X && !check_collision(jerry, 1, 0))
-    {
-        jerry.x++;
-    }
-    else if (c == 'i')
-    {
-        output_state();
-    }
-    else if (c == 'p')
-    {
-        paused();
-    }
-    else if (c == 'l')
-    {
-        if (current_level == 1)
-        {
-            current_level = 2;
-            setup_vars();
-        }
-        else
-        {
-            game_over = true;
-        }
-    }
-    else if (c == 'f')
-    {
-        shoot_firework();
-    }
+// Milliseconds since the game clock started. One overflow is 65536 cycles, or
+// 8.192 ms, split as 8 + 24/125 to stay in 32 bits for ~15 days.
+uint32_t clock_ms()
+{
+    uint32_t count;
+    uint16_t tcnt;
+    hal_clock_read(&count, &tcnt);
+    return count * 8 + (count * 24 + (tcnt >> 6)) / 125;
 }
 
-ISR(TIMER3_OVF_vect)
+// Milliseconds of unpaused play since the level started, stopped while paused
+uint32_t game_ms()
 {
-    cycle_count++;
+    if (game_paused)
+    {
+        return pause_start - pause_time;
+    }
+    return clock_ms() - pause_time;
 }
 
-double elapsed_time()
+// Format a status bar field, "<label><value>", only when its value changes
+void update_field(char *text, char *end, int32_t *shown, int32_t value, const char *label)
 {
-    return (cycle_count * 65536.0 + TCNT3) * (1.0 / 8000000.0);
+    if (value != *shown)
+    {
+        *shown = value;
+        fmt_int(fmt_str_P(text, end, label), end, value);
+    }
 }
 
 void draw_gui(void)
 {
-    char str_buffer[20];
+    // Text as last formatted, and the values it shows. INT32_MIN forces
+    // formatting on the first call.
+    static char level_text[14], lives_text[14], score_text[14], time_text[12];
+    static int32_t level_shown = INT32_MIN, lives_shown = INT32_MIN, score_shown = INT32_MIN, seconds_shown = INT32_MIN;
 
-    sprintf(str_buffer, "L:%d", current_level);
-    draw_string(0, 0, str_buffer, FG_COLOUR);
+    update_field(level_text, FMT_END(level_text), &level_shown, current_level, PSTR("L:"));
+    update_field(lives_text, FMT_END(lives_text), &lives_shown, jerry.lives, PSTR("H:"));
+    update_field(score_text, FMT_END(score_text), &score_shown, jerry.score, PSTR("S:"));
 
-    sprintf(str_buffer, "H:%d", jerry.lives);
-    draw_string(18, 0, str_buffer, FG_COLOUR);
-
-    sprintf(str_buffer, "S:%d", jerry.score);
-    draw_string(36, 0, str_buffer, FG_COLOUR);
+    int32_t seconds = game_time / 1000;
+    if (seconds != seconds_shown)
+    {
+        seconds_shown = seconds;
+        fmt_mmss(time_text, FMT_END(time_text), seconds);
+    }
 
-    int i_minutes = floor(game_time / 60.0);
-    double fl_minutes = game_time / 60.0;
-    double fraction = fl_minutes - floor(fl_minutes);
-    int seconds = 60.0 * fraction;
-    sprintf(str_buffer, "%02d:%02d", i_minutes, seconds);
-    draw_string(55, 0, str_buffer, FG_COLOUR);
+    draw_string(0, 0, level_text, FG_COLOUR);
+    draw_string(18, 0, lives_text, FG_COLOUR);
+    draw_string(36, 0, score_text, FG_COLOUR);
+    draw_string(55, 0, time_text, FG_COLOUR);
 
     draw_line(0, STATUS_BAR_HEIGHT, LCD_X, STATUS_BAR_HEIGHT, FG_COLOUR);
 }
 
 void draw_jerry(void)
 {
-    // Draw Bitmap
-    for (int i = 0; i < OBJ_SIZE; i++)
-    {
-        for (int j = 0; j < OBJ_SIZE; j++)
-        {
-            if (jerry_bitmap[j][i] == 1)
-            {
-                draw_pixel(jerry.x + i, jerry.y + j, FG_COLOUR);
-            }
-        }
-    }
+    draw_sprite(fix_trunc(jerry.x), fix_trunc(jerry.y), &jerry_sprite);
 }
 
 void draw_tom(void)
 {
-    // Draw Bitmap
-    for (int i = 0; i < OBJ_SIZE; i++)
-    {
-        for (int j = 0; j < OBJ_SIZE; j++)
-        {
-            if (tom_bitmap[j][i] == 1)
-            {
-                draw_pixel(tom.x + i, tom.y + j, FG_COLOUR);
-            }
-        }
-    }
+    draw_sprite(fix_trunc(tom.x), fix_trunc(tom.y), &tom_sprite);
 }
 
 void draw_walls(void)
 {
-    struct wall wall_arr[6] = {wall_1, wall_2, wall_3, wall_4, wall_5, wall_6};
-
-    for (int i = 0; i < 6; i++)
+    for (int i = 0; i < num_walls; i++)
     {
-        draw_line(wall_arr[i].x1, wall_arr[i].y1, wall_arr[i].x2, wall_arr[i].y2, FG_COLOUR);
+        const struct wall *wl = &walls[i];
+        draw_line(fix_trunc(wl->x1), fix_trunc(wl->y1), fix_trunc(wl->x2), fix_trunc(wl->y2), FG_COLOUR);
     }
 }
 
@@ -529,70 +610,42 @@ void draw_objs(void)
 {
     for (int i = 0; i < 5; i++)
     {
-        for (int j = 0; j < OBJ_SIZE; j++)
+        if (cheese_positions[i][0] != -10)
         {
-            for (int k = 0; k < OBJ_SIZE; k++)
-            {
-                if (cheese_positions[i][0] != -10)
-                {
-                    if (cheese_bitmap[j][k] == 1)
-                    {
-                        draw_pixel(cheese_positions[i][0] + k, cheese_positions[i][1] + j, FG_COLOUR);
-                    }
-                }
+            draw_sprite(cheese_positions[i][0], cheese_positions[i][1], &cheese_sprite);
+        }
 
-                if (trap_positions[i][0] != -10)
-                {
-                    if (trap_bitmap[j][k] == 1)
-                    {
-                        draw_pixel(trap_positions[i][0] + k, trap_positions[i][1] + j, FG_COLOUR);
-                    }
-                }
+        if (trap_positions[i][0] != -10)
+        {
+            draw_sprite(trap_positions[i][0], trap_positions[i][1], &trap_sprite);
+        }
+    }
 
-                if (i == 0 && door_position[0] != -10)
-                {
-                    if (door_bitmap[j][k] == 1)
-                    {
-                        draw_pixel(door_position[0] + k, door_position[1] + j, FG_COLOUR);
-                    }
-                }
+    if (door_position[0] != -10)
+    {
+        draw_sprite(door_position[0], door_position[1], &door_sprite);
+    }
 
-                if (i == 0 && milk_position[0] != -10)
-                {
-                    if (milk_bitmap[j][k] == 1)
-                    {
-                        draw_pixel(milk_position[0] + k, milk_position[1] + j, FG_COLOUR);
-                    }
-                }
-            }
-        }
+    if (milk_position[0] != -10)
+    {
+        draw_sprite(milk_position[0], milk_position[1], &milk_sprite);
     }
 }
 
 void draw_fireworks()
 {
-    for (int i = 0; i < 20; i++)
+    for (int i = 0; i < MAX_FIREWORKS; i++)
     {
-        if (fireworks[i].x != -1)
+        if (fireworks[i].x != FIX_INT(-1))
         {
-            draw_pixel(fireworks[i].x, fireworks[i].y, FG_COLOUR);
+            draw_pixel(fix_trunc(fireworks[i].x), fix_trunc(fireworks[i].y), FG_COLOUR);
         }
     }
 }
 
 void draw_super_jerry()
 {
-    // Draw Bitmap
-    for (int i = 0; i < OBJ_SIZE + 1; i++)
-    {
-        for (int j = 0; j < OBJ_SIZE + 1; j++)
-        {
-            if (super_jerry_bitmap[j][i] == 1)
-            {
-                draw_pixel(jerry.x + i, jerry.y + j, FG_COLOUR);
-            }
-        }
-    }
+    draw_sprite(fix_trunc(jerry.x), fix_trunc(jerry.y), &super_jerry_sprite);
 }
 
 void draw(void)
@@ -605,63 +658,66 @@ void draw(void)
     draw_tom();
 }
 
-bool is_pixel(int x, int y)
+// Whether any wall touches the w x h pixel box with top-left corner (x, y)
+bool is_wall(fixed_t x, fixed_t y, fixed_t w, fixed_t h)
 {
-    uint8_t bank = y >> 3;
-    uint8_t pixel = y & 7;
+    // Walls are drawn through pixel centres, so compare the segments with
+    // the box shifted by half a pixel: the pixel at (x, y) is hit by any
+    // wall passing within half a pixel of (x + 0.5, y + 0.5).
+    box_t box = {x - FIX_HALF, y - FIX_HALF, x + w - FIX_HALF, y + h - FIX_HALF};
 
-    if (((screen_buffer[bank * LCD_X + (int)x] >> pixel) & 1) == 1)
-    {
-        return true;
-    }
-    else
+    for (int i = 0; i < num_walls; i++)
     {
-        return false;
+        const struct wall *wl = &walls[i];
+        if (segment_hits_box(wl->x1, wl->y1, wl->x2, wl->y2, &wl->bounds, &box))
+        {
+            return true;
+        }
     }
+
+    return false;
+}
+
+bool is_pixel(fixed_t x, fixed_t y)
+{
+    return is_wall(x, y, FIX_ONE, FIX_ONE);
 }
 
 bool wall_collision(struct player plyr, int dx, int dy)
 {
+    // Test the strip of pixels just outside the edge being moved towards
     if (dx < 0 || dx > 0)
     {
-        for (int i = 0; i < OBJ_SIZE; i++)
-        {
-            int x = dx < 0 ? plyr.x + dx : plyr.x + OBJ_SIZE;
-            int y = plyr.y + i;
+        fixed_t x = plyr.x + FIX_INT(dx < 0 ? dx : OBJ_SIZE);
 
-            if (is_pixel(x, y))
-            {
-                return true;
-            }
+        if (is_wall(x, plyr.y, FIX_ONE, FIX_INT(OBJ_SIZE)))
+        {
+            return true;
         }
     }
     if (dy < 0 || dy > 0)
     {
-        for (int i = 0; i < OBJ_SIZE; i++)
-        {
-            int x = plyr.x + i;
-            int y = dy > 0 ? plyr.y + OBJ_SIZE : plyr.y + dy;
+        fixed_t y = plyr.y + FIX_INT(dy > 0 ? OBJ_SIZE : dy);
 
-            if (is_pixel(x, y))
-            {
-                return true;
-            }
+        if (is_wall(plyr.x, y, FIX_INT(OBJ_SIZE), FIX_ONE))
+        {
+            return true;
         }
     }
 
     return false;
 }
 
-bool box_collision(double dx, double dy, int x1, int y1, int x2, int y2, int offset)
+bool box_collision(fixed_t dx, fixed_t dy, int x1, int y1, int x2, int y2, int offset)
 {
     // If one rectangle is on left side of other
-    if (x1 + dx > x2 + OBJ_SIZE - offset || x2 > x1 + dx + OBJ_SIZE - offset)
+    if (FIX_INT(x1) + dx > FIX_INT(x2 + OBJ_SIZE - offset) || FIX_INT(x2) > FIX_INT(x1 + OBJ_SIZE - offset) + dx)
     {
         return false;
     }
 
     // If one rectangle is above other
-    if (y1 + dy > y2 + OBJ_SIZE - offset || y2 > y1 + dy + OBJ_SIZE - offset)
+    if (FIX_INT(y1) + dy > FIX_INT(y2 + OBJ_SIZE - offset) || FIX_INT(y2) > FIX_INT(y1 + OBJ_SIZE - offset) + dy)
     {
         return false;
     }
@@ -669,39 +725,28 @@ bool box_collision(double dx, double dy, int x1, int y1, int x2, int y2, int off
     return true;
 }
 
-bool check_collision(struct player plyr, double dx, double dy)
+bool check_collision(struct player plyr, fixed_t dx, fixed_t dy)
 {
     bool collided = false;
     if (!super_activated)
     {
-        if (dx > 0)
-        {
-            dx = 1;
-        }
-        else if (dx < 0)
-        {
-            dx = -1;
-        }
-
-        if (dy > 0)
-        {
-            dy = 1;
-        }
-        else if (dy < 0)
-        {
-            dy = -1;
-        }
-
-        collided = wall_collision(plyr, dx, dy);
+        collided = wall_collision(plyr, SIGN(dx), SIGN(dy));
     }
 
     return collided;
 }
 
+// Random fraction in [0, 1]. avr-libc's rand() is 15 bits; the mask gives
+// the same range from a host's wider rand() instead of overflowing.
+fixed_t random_fraction()
+{
+    return (fixed_t)(rand() & 0x7FFF) * FIX_ONE / 0x7FFF;
+}
+
 void randomize_tom()
 {
-    tom.speed = ((double)rand() / (double)RAND_MAX * MINSPEED + MINSPEED) * player_speed;
-    tom.direction = ((double)rand() / (double)RAND_MAX) * M_PI * 2;
+    tom.speed = fix_mul(fix_mul(random_fraction(), MINSPEED) + MINSPEED, player_speed);
+    tom.direction = random_fraction(); // [0, 1] turn == [0, ANGLE_TURN]
 }
 
 void reset_jerry()
@@ -716,13 +761,13 @@ void reset_tom()
     tom.y = tom.init_y;
 }
 
-void check_tom_collision(double dx, double dy)
+void check_tom_collision(fixed_t dx, fixed_t dy)
 {
-    int x = round(jerry.x);
-    int y = round(jerry.y);
-    if (!box_collision(dx, dy, x, y, tom.x, tom.y, 1))
+    int x = fix_round(jerry.x);
+    int y = fix_round(jerry.y);
+    if (!box_collision(dx, dy, x, y, fix_trunc(tom.x), fix_trunc(tom.y), 1))
     {
-        if (x + dx + OBJ_SIZE + super_activated < LCD_X && x + dx >= 0 && y + dy + OBJ_SIZE + super_activated < LCD_Y + 1 && y + dy > STATUS_BAR_HEIGHT && !check_collision(jerry, dx, dy))
+        if (FIX_INT(x + OBJ_SIZE + super_activated) + dx < FIX_INT(LCD_X) && FIX_INT(x) + dx >= 0 && FIX_INT(y + OBJ_SIZE + super_activated) + dy < FIX_INT(LCD_Y + 1) && FIX_INT(y) + dy > FIX_INT(STATUS_BAR_HEIGHT) && !check_collision(jerry, dx, dy))
         {
             jerry.x += dx;
             jerry.y += dy;
@@ -746,81 +791,101 @@ void check_tom_collision(double dx, double dy)
 
 void check_cheese_trap_collision()
 {
+    int x = fix_trunc(jerry.x);
+    int y = fix_trunc(jerry.y);
+
     for (int i = 0; i < 5; i++)
     {
-        if (box_collision(0, 0, jerry.x, jerry.y, cheese_positions[i][0], cheese_positions[i][1], 1))
+        if (box_collision(0, 0, x, y, cheese_positions[i][0], cheese_positions[i][1], 1))
         {
             jerry.score++;
             cheese_collected++;
             cheese--;
             cheese_positions[i][0] = -10;
             cheese_positions[i][1] = -10;
+            schedule_cheese();
+            if (cheese_collected == 5)
+            {
+                event_schedule(spawn_door, game_ms());
+            }
         }
 
-        if (!super_activated && box_collision(0, 0, jerry.x, jerry.y, trap_positions[i][0], trap_positions[i][1], 1))
+        if (!super_activated && box_collision(0, 0, x, y, trap_positions[i][0], trap_positions[i][1], 1))
         {
             jerry.lives--;
             traps--;
             trap_positions[i][0] = -10;
             trap_positions[i][1] = -10;
+            schedule_trap();
         }
     }
 
-    if (milk_placed == 1 && box_collision(0, 0, jerry.x, jerry.y, milk_position[0], milk_position[1], 1))
+    if (milk_placed == 1 && box_collision(0, 0, x, y, milk_position[0], milk_position[1], 1))
     {
         super_activated = 1;
-        super_time = round(elapsed_time());
+        event_schedule(end_super, game_ms() + SUPER_DURATION);
         milk_position[0] = -10;
         milk_position[1] = -10;
         milk_placed = 0;
+        schedule_milk();
     }
 }
 
 void firework_homing(struct firework *frwrk)
 {
-    double t1 = tom.x - frwrk->x;
-    double t2 = tom.y - frwrk->y;
-    double d = sqrt(t1 * t1 + t2 * t2);
+    fixed_t dx = tom.x - frwrk->x;
+    fixed_t dy = tom.y - frwrk->y;
+
+    // A firework sitting exactly on Tom has no direction; drop it.
+    if (!fix_normalize(&dx, &dy))
+    {
+        dx = FIX_INT(LCD_X);
+    }
 
-    double dx = t1 * (1 / d);
-    double dy = t2 * (1 / d);
+    fixed_t x = frwrk->x + dx;
+    fixed_t y = frwrk->y + dy;
 
-    if (frwrk->x + dx < LCD_X && frwrk->x + dx > 1 && frwrk->y + dy < LCD_Y && frwrk->y + dy > 5)
+    if (x < FIX_INT(LCD_X) && x > FIX_ONE && y < FIX_INT(LCD_Y) && y > FIX_INT(5))
     {
-        if (!is_pixel(frwrk->x + dx, frwrk->y + dy) && !is_pixel(frwrk->x + dx, frwrk->y) && !is_pixel(frwrk->x, frwrk->y + dy))
+        if (!is_pixel(x, y) && !is_pixel(x, frwrk->y) && !is_pixel(frwrk->x, y))
         {
             frwrk->x += dx;
             frwrk->y += dy;
         }
         else
         {
-            frwrk->x = -1;
-            frwrk->y = -1;
+            frwrk->x = FIX_INT(-1);
+            frwrk->y = FIX_INT(-1);
             jerry.fireworks++;
         }
     }
     else
     {
-        frwrk->x = -1;
-        frwrk->y = -1;
+        frwrk->x = FIX_INT(-1);
+        frwrk->y = FIX_INT(-1);
         jerry.fireworks++;
     }
 }
 
 void update_fireworks()
 {
-    for (int i = 0; i < 20; i++)
+    for (int i = 0; i < MAX_FIREWORKS; i++)
     {
-        if (fireworks[i].x != -1)
+        if (fireworks[i].x != FIX_INT(-1))
         {
-            if ((round(fireworks[i].x) >= round(tom.x) && round(fireworks[i].x) < round(tom.x + OBJ_SIZE)) && (round(fireworks[i].y) >= round(tom.y) && round(fireworks[i].y) < round(tom.y + OBJ_SIZE)))
+            int x = fix_round(fireworks[i].x);
+            int y = fix_round(fireworks[i].y);
+            int tx = fix_round(tom.x);
+            int ty = fix_round(tom.y);
+
+            if (x >= tx && x < tx + OBJ_SIZE && y >= ty && y < ty + OBJ_SIZE)
             {
                 reset_tom();
-                fireworks[i].x = -1;
-                fireworks[i].y = -1;
+                fireworks[i].x = FIX_INT(-1);
+                fireworks[i].y = FIX_INT(-1);
                 jerry.fireworks++;
             }
-            else if (!pause)
+            else if (!game_paused)
             {
 
                 struct firework *ptr = &fireworks[i];
@@ -832,9 +897,9 @@ void update_fireworks()
 
 void shoot_firework()
 {
-    for (int i = 0; i < 20; i++)
+    for (int i = 0; i < MAX_FIREWORKS; i++)
     {
-        if (fireworks[i].x == -1)
+        if (fireworks[i].x == FIX_INT(-1))
         {
             fireworks[i].x = jerry.x;
             fireworks[i].y = jerry.y;
@@ -846,8 +911,8 @@ void shoot_firework()
 
 void handle_player(void)
 {
-    double dx = 0;
-    double dy = 0;
+    fixed_t dx = 0;
+    fixed_t dy = 0;
 
     if (jerry.lives == 0)
     {
@@ -856,47 +921,34 @@ void handle_player(void)
 
     if (jerry.score == 3 && jerry.fireworks == 0 && current_level == 1)
     {
-        jerry.fireworks = 20;
-    }
-
-    if ((door_position[0] != -10 && box_collision(0, 0, jerry.x, jerry.y, door_position[0], door_position[1], 0)) || (switch_states[1] == 1 && current_level == 1))
-    {
-        if (current_level == 1)
-        {
-            current_level = 2;
-            setup_vars();
-        }
-        else
-        {
-            game_over = true;
-        }
+        jerry.fireworks = MAX_FIREWORKS;
     }
 
-    if (round(elapsed_time()) - super_time >= 10 && !pause)
+    if ((door_position[0] != -10 && box_collision(0, 0, fix_trunc(jerry.x), fix_trunc(jerry.y), door_position[0], door_position[1], 0)) || (SWITCH_PRESSED(SW2) && current_level < NUM_LEVELS))
     {
-        super_activated = 0;
+        next_level();
     }
 
     // Down
-    if (switch_states[2] == 1)
+    if (SWITCH_DOWN(SWA))
     {
-        dy = 1 * player_speed;
+        dy = player_speed;
     }
     // Left
-    else if (switch_states[3] == 1)
+    else if (SWITCH_DOWN(SWB))
     {
-        dx = -1 * player_speed;
+        dx = -player_speed;
     }
     // Up
-    else if (switch_states[4] == 1)
+    else if (SWITCH_DOWN(SWC))
     {
-        dy = -1 * player_speed;
+        dy = -player_speed;
     } // Right
-    else if (switch_states[5] == 1)
+    else if (SWITCH_DOWN(SWD))
     {
-        dx = 1 * player_speed;
+        dx = player_speed;
     }
-    else if (jerry.fireworks > 0 && switch_states[6] == 1)
+    else if (jerry.fireworks > 0 && SWITCH_DOWN(SWCENTER))
     {
         shoot_firework();
     }
@@ -904,40 +956,73 @@ void handle_player(void)
     check_tom_collision(dx, dy);
     check_cheese_trap_collision();
 
-    if (switch_states[0] == 1 && pause_check == false && elapsed_time() > 2)
+    if (SWITCH_PRESSED(SW1) && clock_ms() > 2000)
     {
         paused();
-        pause_check = true;
-    }
-    else if (switch_states[0] == 0 && pause_check == true)
-    {
-        pause_check = false;
     }
 }
 
+// One step of a velocity given with 24 fractional bits rather than 8. The
+// bits below fixed_t's 1/256 pixel are carried in *frac to the next step
+// instead of being truncated away, which would make slow movers drift by
+// several pixels over a screen width.
+fixed_t carry_step(int32_t velocity, uint16_t *frac)
+{
+    int32_t total = velocity + *frac;
+    *frac = total & 0xFFFF;
+    return total >> 16;
+}
+
 void update_enemy(void)
 {
-    double dx = cos(tom.direction) * (tom.speed * player_speed);
-    double dy = sin(tom.direction) * (tom.speed * player_speed);
+    // Speed with 16 fractional bits (at most 0.8 * 2), times the cosine's 8
+    int32_t speed = tom.speed * player_speed;
+    uint16_t frac_x = tom.frac_x;
+    uint16_t frac_y = tom.frac_y;
+    fixed_t dx = carry_step(fix_cos(tom.direction) * speed, &frac_x);
+    fixed_t dy = carry_step(fix_sin(tom.direction) * speed, &frac_y);
     uint8_t xdir = dx < 0 ? 0 : 1;
     uint8_t ydir = dy < 0 ? 0 : 1;
+    fixed_t x = tom.x + dx;
+    fixed_t y = tom.y + dy;
 
-    if ((tom.x + dx + (OBJ_SIZE * xdir) > LCD_X) || (tom.x + dx < 0) || (tom.y + dy + (OBJ_SIZE * ydir) > LCD_Y) || (tom.y + dy < STATUS_BAR_HEIGHT + 1) || check_collision(tom, dx, dy) || check_collision(tom, dx, 0) || check_collision(tom, 0, dy))
+    if ((x + FIX_INT(OBJ_SIZE * xdir) > FIX_INT(LCD_X)) || (x < 0) || (y + FIX_INT(OBJ_SIZE * ydir) > FIX_INT(LCD_Y)) || (y < FIX_INT(STATUS_BAR_HEIGHT + 1)) || check_collision(tom, dx, dy) || check_collision(tom, dx, 0) || check_collision(tom, 0, dy))
     {
         randomize_tom();
     }
     else
     {
-        if ((tom.x + dx < LCD_X - 1) && (tom.x + dx > 0))
+        if ((x < FIX_INT(LCD_X - 1)) && (x > 0))
         {
-            tom.x += dx;
+            tom.x = x;
+            tom.frac_x = frac_x;
         }
 
-        if (tom.y + dy < LCD_Y - 1 && tom.y + dy > STATUS_BAR_HEIGHT)
+        if (y < FIX_INT(LCD_Y - 1) && y > FIX_INT(STATUS_BAR_HEIGHT))
+        {
+            tom.y = y;
+            tom.frac_y = frac_y;
+        }
+    }
+}
+
+// Whether a box at (x, y) would overlap a character or a placed object
+bool is_object(int x, int y)
+{
+    if (box_collision(0, 0, x, y, fix_trunc(jerry.x), fix_trunc(jerry.y), 0) || box_collision(0, 0, x, y, fix_trunc(tom.x), fix_trunc(tom.y), 0) || box_collision(0, 0, x, y, door_position[0], door_position[1], 0) || box_collision(0, 0, x, y, milk_position[0], milk_position[1], 0))
+    {
+        return true;
+    }
+
+    for (int i = 0; i < 5; i++)
+    {
+        if (box_collision(0, 0, x, y, cheese_positions[i][0], cheese_positions[i][1], 0) || box_collision(0, 0, x, y, trap_positions[i][0], trap_positions[i][1], 0))
         {
-            tom.y += dy;
+            return true;
         }
     }
+
+    return false;
 }
 
 int *find_clear()
@@ -947,22 +1032,12 @@ int *find_clear()
 
     do
     {
-        x = round(((double)rand() / (double)RAND_MAX) * (LCD_X - OBJ_SIZE));
-        y = round(((double)rand() / (double)RAND_MAX) * (LCD_Y - STATUS_BAR_HEIGHT - OBJ_SIZE)) + STATUS_BAR_HEIGHT + OBJ_SIZE;
+        x = fix_round(random_fraction() * (LCD_X - OBJ_SIZE));
+        y = fix_round(random_fraction() * (LCD_Y - STATUS_BAR_HEIGHT - OBJ_SIZE)) + STATUS_BAR_HEIGHT + OBJ_SIZE;
         blocked = 0;
         if (x + OBJ_SIZE < LCD_X && x > 0 && y > STATUS_BAR_HEIGHT && y + OBJ_SIZE < LCD_Y)
         {
-            for (int j = 0; j < OBJ_SIZE; j++)
-            {
-                for (int k = 0; k < OBJ_SIZE; k++)
-                {
-                    if (is_pixel(x + j, y + k))
-                    {
-                        blocked = 1;
-                        break;
-                    }
-                }
-            }
+            blocked = is_wall(FIX_INT(x), FIX_INT(y), FIX_INT(OBJ_SIZE), FIX_INT(OBJ_SIZE)) || is_object(x, y);
         }
         else
         {
@@ -1001,16 +1076,16 @@ void place_cheese_door(char c)
         door_position[0] = x;
         door_position[1] = y;
     }
-
-    cheese_time = round(elapsed_time());
 }
 
 void place_trap()
 {
     int blocked = 0;
+    int x = fix_trunc(tom.x);
+    int y = fix_trunc(tom.y);
     for (int i = 0; i < 5; i++)
     {
-        if (box_collision(0, 0, tom.x, tom.y, cheese_positions[i][0], cheese_positions[i][1], 0) || box_collision(0, 0, tom.x, tom.y, trap_positions[i][0], trap_positions[i][1], 0) || box_collision(0, 0, tom.x, tom.y, door_position[0], door_position[1], 0) || box_collision(0, 0, tom.x, tom.y, milk_position[0], milk_position[1], 0))
+        if (box_collision(0, 0, x, y, cheese_positions[i][0], cheese_positions[i][1], 0) || box_collision(0, 0, x, y, trap_positions[i][0], trap_positions[i][1], 0) || box_collision(0, 0, x, y, door_position[0], door_position[1], 0) || box_collision(0, 0, x, y, milk_position[0], milk_position[1], 0))
         {
             blocked = 1;
             break;
@@ -1023,23 +1098,25 @@ void place_trap()
         {
             if (trap_positions[i][0] == -10)
             {
-                trap_positions[i][0] = round(tom.x);
-                trap_positions[i][1] = round(tom.y);
+                trap_positions[i][0] = fix_round(tom.x);
+                trap_positions[i][1] = fix_round(tom.y);
                 traps++;
                 placing_trap = 0;
+                schedule_trap();
                 break;
             }
         }
     }
-    trap_time = round(elapsed_time());
 }
 
 void place_milk()
 {
     int blocked = 0;
+    int x = fix_trunc(tom.x);
+    int y = fix_trunc(tom.y);
     for (int i = 0; i < 5; i++)
     {
-        if (box_collision(0, 0, tom.x, tom.y, cheese_positions[i][0], cheese_positions[i][1], 0) || box_collision(0, 0, tom.x, tom.y, trap_positions[i][0], trap_positions[i][1], 0))
+        if (box_collision(0, 0, x, y, cheese_positions[i][0], cheese_positions[i][1], 0) || box_collision(0, 0, x, y, trap_positions[i][0], trap_positions[i][1], 0))
         {
             blocked = 1;
             break;
@@ -1048,162 +1125,177 @@ void place_milk()
 
     if (blocked == 0)
     {
-        milk_position[0] = tom.x;
-        milk_position[1] = tom.y;
+        milk_position[0] = x;
+        milk_position[1] = y;
         milk_placed = 1;
         placing_milk = 0;
     }
-
-    milk_time = round(elapsed_time());
 }
 
-void place_cheese_traps()
+// Timed events. Each spawn schedules the next one while there is room for
+// it; collecting or springing an object schedules a replacement.
+void spawn_cheese()
 {
-    int current_time = round(elapsed_time());
+    place_cheese_door('C');
+    schedule_cheese();
+}
 
-    if (cheese_collected == 5 && door_position[0] == -10)
+void schedule_cheese()
+{
+    if (cheese < level.max_cheese && !event_pending(spawn_cheese))
     {
-        place_cheese_door('D');
+        event_schedule(spawn_cheese, game_ms() + level.cheese_interval);
     }
+}
 
-    if (cheese < 5 && current_time - cheese_time == 2 && !pause)
-    {
-        place_cheese_door('C');
-    }
-    else if (cheese == 5 || pause)
+void spawn_door()
+{
+    if (door_position[0] == -10)
     {
-        cheese_time = round(elapsed_time());
+        place_cheese_door('D');
     }
+}
 
-    if (placing_trap || (traps < 5 && current_time - trap_time == 3 && !pause))
-    {
-        placing_trap = 1;
-        place_trap();
-    }
-    else if (traps == 5 || pause)
-    {
-        trap_time = round(elapsed_time());
-    }
+// Traps and milk are dropped where Tom is, so placement is retried every
+// step until he is somewhere clear
+void spawn_trap()
+{
+    placing_trap = 1;
+}
 
-    if (current_level == 2)
+void schedule_trap()
+{
+    if (traps < level.max_traps && !placing_trap && !event_pending(spawn_trap))
     {
-        if (placing_milk || (milk_placed == 0 && current_time - milk_time == 5 && !pause))
-        {
-            placing_milk = 1;
-            place_milk();
-        }
-        else if (milk_placed == 1 || pause)
-        {
-            milk_time = round(elapsed_time());
-        }
+        event_schedule(spawn_trap, game_ms() + level.trap_interval);
     }
 }
 
-void check_wall_wrap(struct wall *w)
+void spawn_milk()
 {
-    double dx = w->x2 - w->x1;
-    double dy = w->y2 - w->y1;
-    if (w->y1 < STATUS_BAR_HEIGHT && w->y2 < STATUS_BAR_HEIGHT)
-    {
+    placing_milk = 1;
+}
+
+void schedule_milk()
+{
+    if (level.milk_interval != 0 && !milk_placed && !placing_milk && !event_pending(spawn_milk))
+    {
+        event_schedule(spawn_milk, game_ms() + level.milk_interval);
+    }
+}
+
+void end_super()
+{
+    super_activated = 0;
+}
+
+void place_cheese_traps()
+{
+    if (game_paused)
+    {
+        return;
+    }
+
+    events_run(game_ms());
+
+    if (placing_trap)
+    {
+        place_trap();
+    }
+
+    if (placing_milk)
+    {
+        place_milk();
+    }
+}
+
+void check_wall_wrap(struct wall *w)
+{
+    const fixed_t top = FIX_INT(STATUS_BAR_HEIGHT);
+    const fixed_t bottom = FIX_INT(LCD_Y);
+    const fixed_t right = FIX_INT(LCD_X);
+    fixed_t dx = w->x2 - w->x1;
+    fixed_t dy = w->y2 - w->y1;
+    if (w->y1 < top && w->y2 < top)
+    {
         if (dy != 0)
         {
-            w->y1 = dy > 0 ? LCD_Y : LCD_Y - dy;
-            w->y2 = dy > 0 ? LCD_Y + dy : LCD_Y;
+            w->y1 = dy > 0 ? bottom : bottom - dy;
+            w->y2 = dy > 0 ? bottom + dy : bottom;
         }
         else
         {
-            w->y1 = LCD_Y;
-            w->y2 = LCD_Y;
+            w->y1 = bottom;
+            w->y2 = bottom;
         }
     }
-    if (w->y1 > LCD_Y && w->y2 > LCD_Y)
+    if (w->y1 > bottom && w->y2 > bottom)
     {
         if (dy != 0)
         {
-            w->y1 = dy > 0 ? STATUS_BAR_HEIGHT - dy : STATUS_BAR_HEIGHT;
-            w->y2 = dy > 0 ? STATUS_BAR_HEIGHT : STATUS_BAR_HEIGHT + dy;
+            w->y1 = dy > 0 ? top - dy : top;
+            w->y2 = dy > 0 ? top : top + dy;
         }
         else
         {
-            w->y1 = STATUS_BAR_HEIGHT;
-            w->y2 = STATUS_BAR_HEIGHT;
+            w->y1 = top;
+            w->y2 = top;
         }
     }
-    if (w->x1 > LCD_X && w->x2 > LCD_X)
+    if (w->x1 > right && w->x2 > right)
     {
         w->x1 = dx > 0 ? 0 - dx : 0;
         w->x2 = dx > 0 ? 0 : 0 + dx;
     }
     if (w->x1 < 0 && w->x2 < 0)
     {
-        w->x1 = dx > 0 ? LCD_X : LCD_X - dx;
-        w->x2 = dx > 0 ? LCD_X + dx : LCD_X;
+        w->x1 = dx > 0 ? right : right - dx;
+        w->x2 = dx > 0 ? right + dx : right;
     }
 }
 
 void move_walls()
 {
-    double speed = 0.05 * wall_speed;
-    struct wall *wall_arr[6] = {&wall_1, &wall_2, &wall_3, &wall_4, &wall_5, &wall_6};
-    for (int i = 0; i < 6; i++)
+    // A twentieth of wall_speed per step, with 16 fractional bits: with
+    // only 8 the division would lose up to 5% of the speed.
+    int32_t speed = wall_speed * FIX_ONE / 20;
+    for (int i = 0; i < num_walls; i++)
     {
-        if (wall_arr[i]->x1 != 0 && wall_arr[i]->x2 != 0 && wall_arr[i]->y1 != 0 && wall_arr[i]->y2 != 0)
-        {
-            check_wall_wrap(wall_arr[i]);
+        struct wall *wl = &walls[i];
+        check_wall_wrap(wl);
 
-            double dx, dy;
-            if (wall_arr[i]->y2 - wall_arr[i]->y1 != 0 && wall_arr[i]->x2 - wall_arr[i]->x1 != 0)
-            {
-                double theta = atan(((wall_arr[i]->y2 - wall_arr[i]->y1) / (wall_arr[i]->x2 - wall_arr[i]->x1)));
-                double new_theta = M_PI - theta;
-                dx = cos(new_theta) * speed;
-                dy = sin(new_theta) * speed;
-            }
-            else if (wall_arr[i]->y2 - wall_arr[i]->y1 == 0)
-            {
-                dx = 0;
-                dy = speed;
-            }
-            else
-            {
-                dx = speed;
-                dy = 0;
-            }
+        fixed_t dx = carry_step(wl->dir_x * speed, &wl->frac_x);
+        fixed_t dy = carry_step(wl->dir_y * speed, &wl->frac_y);
 
-            wall_arr[i]->x1 += dx;
-            wall_arr[i]->x2 += dx;
-            wall_arr[i]->y1 += dy;
-            wall_arr[i]->y2 += dy;
-        }
+        wl->x1 += dx;
+        wl->x2 += dx;
+        wl->y1 += dy;
+        wl->y2 += dy;
+        segment_bounds(wl->x1, wl->y1, wl->x2, wl->y2, &wl->bounds);
     }
 }
 
 void check_wall_overlap()
 {
-    for (int i = 0; i < OBJ_SIZE; i++)
+    if (!super_activated && is_wall(jerry.x, jerry.y, FIX_INT(OBJ_SIZE), FIX_INT(OBJ_SIZE)))
     {
-        for (int j = 0; j < OBJ_SIZE; j++)
-        {
-            if (!super_activated && is_pixel(jerry.x + i, jerry.y + j))
-            {
-                reset_jerry();
-            }
+        reset_jerry();
+    }
 
-            if (is_pixel(tom.x + i, tom.y + j))
-            {
-                reset_tom();
-            }
-        }
+    if (is_wall(tom.x, tom.y, FIX_INT(OBJ_SIZE), FIX_INT(OBJ_SIZE)))
+    {
+        reset_tom();
     }
 }
 
 void set_speeds()
 {
-    double left_adc = adc_read(0);
-    double right_adc = adc_read(1);
+    fixed_t left_adc = adc_latest(0);
+    fixed_t right_adc = adc_latest(1);
 
-    player_speed = (left_adc / 1024.0) * 2;
-    wall_speed = ((512.0 - right_adc) / 512.0) * 2;
+    // (left / 1024) * 2 and ((512 - right) / 512) * 2, scaled by FIX_ONE
+    player_speed = left_adc * FIX_ONE / 512;
+    wall_speed = (512 - right_adc) * FIX_ONE / 256;
 }
 
 void adjust_brightness()
@@ -1229,70 +1321,703 @@ void adjust_brightness()
 
 void paused()
 {
-    pause = !pause;
-    if (pause)
+    // Update the times before the flag so game_ms() never sees a stale start
+    if (!game_paused)
     {
-        pause_start = elapsed_time();
-        pause_end = 0;
+        pause_start = clock_ms();
+        game_paused = true;
     }
     else
     {
-        pause_end = elapsed_time();
-        pause_time += pause_end - pause_start;
+        pause_time += clock_ms() - pause_start;
+        game_paused = false;
     }
 }
 
-void process(void)
+// Game state streamed every step while telemetry is on, little endian.
+// Positions are fixed point (8 fractional bits); timers are milliseconds
+// until the event, or 0 if it is not scheduled.
+struct state_record
 {
-    clear_screen();
+    uint32_t step, time;
+    uint8_t level, lives, flags;
+    int16_t score;
+    uint8_t cheese, cheese_collected, traps, fireworks;
+    int16_t jerry_x, jerry_y, tom_x, tom_y;
+    uint16_t next_cheese, next_trap, next_milk, super_left;
+};
+
+#define STATE_PAUSED 0x01
+#define STATE_SUPER 0x02
+#define STATE_GAME_OVER 0x04
+
+// Milliseconds until fn's event, or 0 when none is scheduled or it is
+// already due but has not run yet
+uint16_t time_until(event_fn fn, uint32_t now)
+{
+    uint32_t due;
+    if (!event_due(fn, &due) || (int32_t)(due - now) <= 0)
+    {
+        return 0;
+    }
+    return due - now;
+}
+
+void send_telemetry(void)
+{
+    struct state_record rec;
+    uint32_t now = game_ms();
+
+    rec.step = timing.steps;
+    rec.time = now;
+    rec.level = current_level;
+    rec.lives = jerry.lives;
+    rec.flags = (game_paused ? STATE_PAUSED : 0) | (super_activated ? STATE_SUPER : 0) | (game_over ? STATE_GAME_OVER : 0);
+    rec.score = jerry.score;
+    rec.cheese = cheese;
+    rec.cheese_collected = cheese_collected;
+    rec.traps = traps;
+    rec.fireworks = 0;
+    for (int i = 0; i < MAX_FIREWORKS; i++)
+    {
+        if (fireworks[i].x != FIX_INT(-1))
+        {
+            rec.fireworks++;
+        }
+    }
+    rec.jerry_x = jerry.x;
+    rec.jerry_y = jerry.y;
+    rec.tom_x = tom.x;
+    rec.tom_y = tom.y;
+    rec.next_cheese = time_until(spawn_cheese, now);
+    rec.next_trap = time_until(spawn_trap, now);
+    rec.next_milk = time_until(spawn_milk, now);
+    rec.super_left = time_until(end_super, now);
+
+    telemetry_send(RECORD_STATE, &rec, sizeof(rec));
+}
+
+#if SAMPLER
+// Stream the sampling profiler's flash addresses, toggled by 'r'
+bool sampling = false;
+
+void send_samples(void)
+{
+    uint16_t samples[32];
+    uint8_t n;
+    while ((n = sampler_take(samples, 32)) > 0)
+    {
+        if (!telemetry_send(RECORD_SAMPLES, samples, n * sizeof(samples[0])))
+        {
+            sampler_lost(n);
+        }
+    }
+}
+#endif
+
+// Move queued telemetry into the USB transmit buffer, once per USB frame
+void usb_serial_sof_hook(void)
+{
+    telemetry_drain(usb_serial_putchar_nowait, TELEMETRY_BURST);
+}
+
+// Room upload parser, for the level text format in level.h. Bytes are fed
+// in as they arrive, so a line can be split across any number of steps,
+// and nothing is read past a fixed-size field. Records go into a staging
+// level that replaces the uploaded room only once the whole upload has
+// been checked.
+enum parse_state
+{
+    PARSE_IDLE,   // Between lines
+    PARSE_FIELDS, // Reading a record's numbers
+    PARSE_SKIP    // Discarding the rest of a bad line
+};
+
+enum parse_result
+{
+    PARSE_NOT_MINE, // Not room data; treat as a command
+    PARSE_CONSUMED,
+    PARSE_DONE // Upload finished
+};
 
-    if (!game_over)
+struct room_parser
+{
+    enum parse_state state;
+    char record;
+    uint8_t field, num_fields;
+    uint32_t value;
+    bool in_number;
+    uint16_t values[4];
+    uint8_t line;
+    uint8_t error_line; // First bad line, or 0
+    bool started;
+    uint32_t last_byte; // clock_ms() of the last byte consumed
+    union level_buffer staging;
+} room_parser;
+
+void room_parser_reset(struct room_parser *p)
+{
+    memset(p, 0, sizeof(*p));
+    p->state = PARSE_IDLE;
+
+    // Anything the upload leaves out keeps the built-in level's value
+    memcpy_P(&p->staging.level, builtin_level(UPLOAD_LEVEL), sizeof(struct level));
+    p->staging.level.num_walls = 0;
+}
+
+void room_parser_reject(struct room_parser *p, uint8_t c)
+{
+    if (p->error_line == 0)
     {
-        set_speeds();
+        p->error_line = p->line;
+    }
+    p->state = c == '\n' ? PARSE_IDLE : PARSE_SKIP;
+}
 
-        if (super_activated)
+// Whether a character's top-left corner at (x, y) keeps it in the play area
+bool room_position_ok(uint16_t x, uint16_t y)
+{
+    return x + OBJ_SIZE <= LCD_X && y > STATUS_BAR_HEIGHT && y + OBJ_SIZE <= LCD_Y;
+}
+
+bool room_interval_ok(uint16_t ms)
+{
+    return ms >= MIN_INTERVAL;
+}
+
+// Check a complete record and store it in the staging level
+bool room_parser_store(struct room_parser *p)
+{
+    struct level *lvl = &p->staging.level;
+    uint16_t *v = p->values;
+
+    if (p->field != p->num_fields)
+    {
+        return false;
+    }
+
+    switch (p->record)
+    {
+    case 'T':
+        if (!room_position_ok(v[0], v[1]))
         {
-            draw_super_jerry();
-            adjust_brightness();
+            return false;
         }
+        lvl->tom_x = v[0];
+        lvl->tom_y = v[1];
+        return true;
 
-        if (!pause)
+    case 'J':
+        if (!room_position_ok(v[0], v[1]))
         {
-            move_walls();
+            return false;
         }
-        draw_walls();
-        if (!pause)
+        lvl->jerry_x = v[0];
+        lvl->jerry_y = v[1];
+        return true;
+
+    case 'C':
+        if (v[0] < 1 || v[0] > MAX_CHEESE || !room_interval_ok(v[1]))
+        {
+            return false;
+        }
+        lvl->max_cheese = v[0];
+        lvl->cheese_interval = v[1];
+        return true;
+
+    case 'P':
+        if (v[0] < 1 || v[0] > MAX_TRAPS || !room_interval_ok(v[1]))
         {
-            check_wall_overlap();
+            return false;
         }
+        lvl->max_traps = v[0];
+        lvl->trap_interval = v[1];
+        return true;
 
-        if (!pause)
+    case 'M':
+        if (v[0] != 0 && !room_interval_ok(v[0]))
         {
-            game_time = elapsed_time() - pause_time;
-            update_enemy();
-            update_fireworks();
+            return false;
         }
+        lvl->milk_interval = v[0];
+        return true;
+    }
 
-        draw();
-        handle_player();
-        draw_fireworks();
-        draw_objs();
-        place_cheese_traps();
+    // 'W'
+    if (lvl->num_walls >= MAX_WALLS)
+    {
+        return false;
+    }
+    for (int i = 0; i < 4; i += 2)
+    {
+        if (v[i] >= LCD_X || v[i + 1] < STATUS_BAR_HEIGHT || v[i + 1] >= LCD_Y)
+        {
+            return false;
+        }
+    }
+    uint8_t *w = lvl->walls[lvl->num_walls++];
+    for (int i = 0; i < 4; i++)
+    {
+        w[i] = v[i];
+    }
+    return true;
+}
+
+// Number of values in each kind of record, or 0 if the letter starts none
+uint8_t room_record_fields(uint8_t c)
+{
+    switch (c)
+    {
+    case 'T':
+    case 'J':
+    case 'C':
+    case 'P':
+        return 2;
+    case 'W':
+        return 4;
+    case 'M':
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+enum parse_result room_parser_feed(struct room_parser *p, uint8_t c)
+{
+    if (p->state == PARSE_IDLE)
+    {
+        if (room_record_fields(c) != 0)
+        {
+            p->state = PARSE_FIELDS;
+            p->record = c;
+            p->num_fields = room_record_fields(c);
+            p->field = 0;
+            p->value = 0;
+            p->in_number = false;
+            p->line++;
+            p->started = true;
+        }
+        else if (!p->started)
+        {
+            return PARSE_NOT_MINE;
+        }
+        else if (c == '\n' || c == 0 || c == 4)
+        {
+            // Blank line, NUL or EOT: the upload is complete
+            return PARSE_DONE;
+        }
+        else if (c != '\r' && c != ' ')
+        {
+            return PARSE_NOT_MINE;
+        }
+    }
+    else if (p->state == PARSE_FIELDS)
+    {
+        if (c >= '0' && c <= '9')
+        {
+            p->value = p->value * 10 + c - '0';
+            p->in_number = true;
+            if (p->value > UINT16_MAX)
+            {
+                room_parser_reject(p, c);
+            }
+        }
+        else if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+        {
+            if (p->in_number)
+            {
+                if (p->field >= p->num_fields)
+                {
+                    room_parser_reject(p, c);
+                    return PARSE_CONSUMED;
+                }
+                p->values[p->field++] = p->value;
+                p->value = 0;
+                p->in_number = false;
+            }
+            if (c == '\n')
+            {
+                if (room_parser_store(p))
+                {
+                    p->state = PARSE_IDLE;
+                }
+                else
+                {
+                    room_parser_reject(p, c);
+                }
+            }
+        }
+        else
+        {
+            room_parser_reject(p, c);
+        }
+    }
+    else if (c == '\n')
+    {
+        p->state = PARSE_IDLE;
+    }
+
+    return PARSE_CONSUMED;
+}
+
+// Commit the staged room if every line was good, and report the outcome
+void room_upload_finish(void)
+{
+    struct room_parser *p = &room_parser;
+
+    // A last line without a newline still counts
+    if (p->state == PARSE_FIELDS)
+    {
+        room_parser_feed(p, '\n');
+    }
+
+    if (p->error_line != 0 || p->state != PARSE_IDLE)
+    {
+        send_value(PSTR("Room rejected, bad line: "), p->error_line ? p->error_line : p->line);
     }
     else
+    {
+        uploaded_room = p->staging;
+        room_uploaded = true;
+        send_value(PSTR("Room loaded, walls: "), uploaded_room.level.num_walls);
+        if (current_level == UPLOAD_LEVEL)
+        {
+            setup_vars();
+        }
+    }
+
+    room_parser_reset(p);
+}
+
+// Serial commands
+enum command
+{
+    CMD_NONE,
+    CMD_DOWN,
+    CMD_LEFT,
+    CMD_UP,
+    CMD_RIGHT,
+    CMD_INFO,
+    CMD_PAUSE,
+    CMD_LEVEL,
+    CMD_FIREWORK,
+    CMD_TELEMETRY,
+    CMD_MEMORY,
+    CMD_PROFILE,
+    CMD_SAMPLE
+};
+
+enum command decode_command(uint8_t c)
+{
+    switch (c)
+    {
+    case 's':
+        return CMD_DOWN;
+    case 'a':
+        return CMD_LEFT;
+    case 'w':
+        return CMD_UP;
+    case 'd':
+        return CMD_RIGHT;
+    case 'i':
+        return CMD_INFO;
+    case 'p':
+        return CMD_PAUSE;
+    case 'l':
+        return CMD_LEVEL;
+    case 'f':
+        return CMD_FIREWORK;
+    case 't':
+        return CMD_TELEMETRY;
+    case 'm':
+        return CMD_MEMORY;
+#if PROFILE
+    case 'o':
+        return CMD_PROFILE;
+#endif
+#if SAMPLER
+    case 'r':
+        return CMD_SAMPLE;
+#endif
+    default:
+        return CMD_NONE;
+    }
+}
+
+void run_command(enum command cmd)
+{
+    // Down
+    if (cmd == CMD_DOWN && jerry.y + FIX_INT(OBJ_SIZE + 1) < FIX_INT(LCD_Y) && !check_collision(jerry, 0, FIX_ONE))
+    {
+        jerry.y += FIX_ONE;
+    }
+    // Left
+    else if (cmd == CMD_LEFT && jerry.x - FIX_ONE > 0 && !check_collision(jerry, -FIX_ONE, 0))
+    {
+        jerry.x -= FIX_ONE;
+    }
+    // Up
+    else if (cmd == CMD_UP && jerry.y - FIX_ONE > FIX_INT(STATUS_BAR_HEIGHT) && !check_collision(jerry, 0, -FIX_ONE))
+    {
+        jerry.y -= FIX_ONE;
+    } // Right
+    else if (cmd == CMD_RIGHT && jerry.x + FIX_INT(1 + OBJ_SIZE) < FIX_INT(LCD_X) && !check_collision(jerry, FIX_ONE, 0))
+    {
+        jerry.x += FIX_ONE;
+    }
+    else if (cmd == CMD_INFO)
+    {
+        output_state();
+    }
+    else if (cmd == CMD_PAUSE)
+    {
+        paused();
+    }
+    else if (cmd == CMD_LEVEL)
+    {
+        next_level();
+    }
+    else if (cmd == CMD_FIREWORK)
+    {
+        shoot_firework();
+    }
+    else if (cmd == CMD_TELEMETRY)
+    {
+        telemetry_on = !telemetry_on;
+    }
+    else if (cmd == CMD_MEMORY)
+    {
+        output_memory();
+    }
+#if PROFILE
+    else if (cmd == CMD_PROFILE)
+    {
+        // "<phase> <runs> <min> <avg> <max>" in cycles, since the last report
+        prof_report(NUM_PHASES, phase_names, send_buffer);
+        output_memory();
+    }
+#endif
+#if SAMPLER
+    else if (cmd == CMD_SAMPLE)
+    {
+        sampling = !sampling;
+        if (sampling)
+        {
+            sampler_start();
+        }
+        else
+        {
+            sampler_stop();
+            send_samples();
+            send_value(PSTR("Samples Dropped: "), sampler_dropped());
+        }
+    }
+#endif
+}
+
+// Act on all serial input received since the last step
+void process_commands(void)
+{
+    uint8_t c;
+    while (!game_over && ring_get(&usb_rx, &c))
+    {
+        enum parse_result result = room_parser_feed(&room_parser, c);
+        if (result == PARSE_NOT_MINE)
+        {
+            if (room_parser.started)
+            {
+                room_upload_finish();
+            }
+            run_command(decode_command(c));
+        }
+        else
+        {
+            room_parser.last_byte = clock_ms();
+            if (result == PARSE_DONE)
+            {
+                room_upload_finish();
+            }
+        }
+    }
+
+    if (room_parser.started && clock_ms() - room_parser.last_byte >= ROOM_IDLE_MS)
+    {
+        room_upload_finish();
+    }
+}
+
+// Advance the game by one fixed step
+void step(void)
+{
+    switch_presses = debounce_take_pressed(&switches);
+    process_commands();
+
+    PROF_BEGIN(PHASE_SET_SPEEDS);
+    set_speeds();
+    PROF_END(PHASE_SET_SPEEDS);
+
+    if (super_activated)
+    {
+        adjust_brightness();
+    }
+
+    if (!game_paused)
+    {
+        PROF_BEGIN(PHASE_MOVE_WALLS);
+        move_walls();
+        PROF_END(PHASE_MOVE_WALLS);
+
+        PROF_BEGIN(PHASE_CHECK_WALL_OVERLAP);
+        check_wall_overlap();
+        PROF_END(PHASE_CHECK_WALL_OVERLAP);
+
+        game_time = game_ms();
+
+        PROF_BEGIN(PHASE_UPDATE_ENEMY);
+        update_enemy();
+        PROF_END(PHASE_UPDATE_ENEMY);
+
+        PROF_BEGIN(PHASE_UPDATE_FIREWORKS);
+        update_fireworks();
+        PROF_END(PHASE_UPDATE_FIREWORKS);
+    }
+
+    PROF_BEGIN(PHASE_HANDLE_PLAYER);
+    handle_player();
+    PROF_END(PHASE_HANDLE_PLAYER);
+
+    PROF_BEGIN(PHASE_PLACE_CHEESE_TRAPS);
+    place_cheese_traps();
+    PROF_END(PHASE_PLACE_CHEESE_TRAPS);
+
+    srand(hal_entropy());
+
+    if (telemetry_on)
+    {
+        send_telemetry();
+    }
+
+#if SAMPLER
+    if (sampling)
+    {
+        send_samples();
+    }
+#endif
+}
+
+// Draw the current game state and send it to the LCD
+void render(void)
+{
+    clear_screen();
+
+    if (super_activated)
+    {
+        draw_super_jerry();
+    }
+
+    PROF_BEGIN(PHASE_DRAW_WALLS);
+    draw_walls();
+    PROF_END(PHASE_DRAW_WALLS);
+
+    PROF_BEGIN(PHASE_DRAW);
+    draw();
+    PROF_END(PHASE_DRAW);
+
+    draw_fireworks();
+
+    PROF_BEGIN(PHASE_DRAW_OBJS);
+    draw_objs();
+    PROF_END(PHASE_DRAW_OBJS);
+
+    PROF_BEGIN(PHASE_SWAP_AND_FLUSH);
+    swap_and_flush();
+    PROF_END(PHASE_SWAP_AND_FLUSH);
+}
+
+void record_cycles(uint32_t *last, uint32_t *max, uint32_t cycles)
+{
+    *last = cycles;
+    if (cycles > *max)
+    {
+        *max = cycles;
+    }
+}
+
+// Main loop state: when the next step falls due, and how many renders in a
+// row have been skipped to catch up
+uint32_t next_step;
+uint8_t renders_skipped;
+
+// One pass of the main loop: wait for the next step, run the steps that are
+// due, then render unless catching up
+void run_frame(void)
+{
+    if (game_over)
     {
         handle_gameover();
+        ring_flush(&usb_rx);
+        next_step = clock_cycles();
+        return;
+    }
+
+    // Wait for the next step to fall due
+    uint32_t start = clock_cycles();
+    while ((int32_t)(clock_cycles() - next_step) < 0)
+    {
+        hal_wait();
+    }
+
+    // Run every step that is due, up to MAX_CATCHUP_STEPS. More than one
+    // means the previous frame overran, so skip this render to catch up.
+    uint32_t now = clock_cycles();
+    timing.idle_cycles = now - start;
+    uint8_t steps = 0;
+    while ((int32_t)(now - next_step) >= 0 && !game_over)
+    {
+        // Too far behind to catch up: give up the steps still due and carry
+        // on from now
+        if (steps == MAX_CATCHUP_STEPS)
+        {
+            timing.skipped += (now - next_step) / STEP_CYCLES;
+            next_step = now;
+            break;
+        }
+
+        step();
+        next_step += STEP_CYCLES;
+        steps++;
+        timing.steps++;
+
+        uint32_t end = clock_cycles();
+        record_cycles(&timing.step_cycles, &timing.step_cycles_max, end - now);
+        now = end;
     }
 
-    show_screen();
-    srand(TCNT0);
+    if (steps > 1 && renders_skipped < MAX_DROPPED_FRAMES)
+    {
+        renders_skipped++;
+        timing.dropped++;
+        return;
+    }
+
+    render();
+    renders_skipped = 0;
+    timing.frames++;
+    record_cycles(&timing.render_cycles, &timing.render_cycles_max, clock_cycles() - now);
 }
 
+// The benchmark firmware (bench/bench.c) and the host tests link in the game
+// with their own main()
+#ifndef GAME_NO_MAIN
 int main(void)
 {
     setup();
+    room_parser_reset(&room_parser);
+
+    next_step = clock_cycles();
     for (;;)
     {
-        process();
+        run_frame();
     }
-}
\ No newline at end of file
+}
+#endif
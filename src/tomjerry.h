@@ -0,0 +1,110 @@
+// Tom and Jerry: the game's shared types, and the state and functions that
+// its host tests (tests/) and the benchmark (bench/) drive directly. Build
+// those with -DGAME_NO_MAIN so that they can supply their own main().
+#ifndef TOMJERRY_H_
+#define TOMJERRY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <fixed.h>
+#include <geometry.h>
+#include <ring.h>
+#include "level.h"
+
+#define STATUS_BAR_HEIGHT 8
+#define OBJ_SIZE 5
+
+// The level replaced by rooms uploaded over USB
+#define UPLOAD_LEVEL 2
+
+// Most fireworks in flight at once
+#define MAX_FIREWORKS 20
+
+// Fixed timestep: the simulation advances once every STEP_CYCLES CPU cycles
+// (two game clock overflows, ~61 Hz). Rendering fills whatever time is left,
+// and at most MAX_DROPPED_FRAMES renders in a row are skipped to catch up.
+// A pass runs at most MAX_CATCHUP_STEPS steps; any more that are due after a
+// stall are skipped, so the game slows down rather than freezing the screen.
+#define STEP_CYCLES (2 * 65536UL)
+#define MAX_DROPPED_FRAMES 4
+#define MAX_CATCHUP_STEPS 8
+
+struct player
+{
+    int lives, score, fireworks;
+    fixed_t init_x, init_y, x, y, speed;
+    angle_t direction;
+    uint16_t frac_x, frac_y; // Motion below 1/256 pixel, see carry_step()
+};
+
+struct firework
+{
+    fixed_t x, y;
+};
+
+struct wall
+{
+    fixed_t x1, y1, x2, y2;
+    fixed_t dir_x, dir_y;    // Unit direction of travel, set by set_wall()
+    uint16_t frac_x, frac_y; // Motion below 1/256 pixel, see carry_step()
+    box_t bounds;            // Bounding box, kept up to date as the wall moves
+};
+
+// Scheduler counters, reported with the game state. Cycle counts are for the
+// most recent pass through the main loop; idle is time spent waiting for the
+// next step, i.e. the headroom left in that frame. Dropped counts renders
+// skipped to catch up, and skipped the steps given up on past the catch-up cap.
+struct frame_timing
+{
+    uint32_t steps, frames, dropped, skipped;
+    uint32_t step_cycles, render_cycles, idle_cycles;
+    uint32_t step_cycles_max, render_cycles_max;
+};
+
+// Game state
+extern int current_level;
+extern bool game_paused, game_over, telemetry_on;
+extern struct player tom, jerry;
+extern struct firework fireworks[MAX_FIREWORKS];
+extern struct wall walls[MAX_WALLS];
+extern uint8_t num_walls;
+
+// Room uploads and serial input
+extern union level_buffer uploaded_room;
+extern bool room_uploaded;
+extern ring_t usb_rx;
+extern struct room_parser room_parser;
+
+// Scheduler
+extern struct frame_timing timing;
+extern uint32_t next_step;
+
+uint32_t clock_cycles(void);
+
+// Levels and walls
+const struct level *builtin_level(int n);
+void load_current_level(void);
+void setup_vars(void);
+void set_wall(struct wall *w, int x1, int y1, int x2, int y2);
+void draw_walls(void);
+bool is_wall(fixed_t x, fixed_t y, fixed_t w, fixed_t h);
+bool wall_collision(struct player plyr, int dx, int dy);
+
+// Simulation
+void randomize_tom(void);
+void shoot_firework(void);
+void move_walls(void);
+void update_enemy(void);
+void update_fireworks(void);
+
+// Serial input
+void process_commands(void);
+void room_parser_reset(struct room_parser *p);
+
+// One fixed step, one render, and one pass of the main loop
+void step(void);
+void render(void);
+void run_frame(void);
+
+#endif /* TOMJERRY_H_ */
@@ -741,6 +741,7 @@ ISR(USB_GEN_vect)
 					UEINTX = 0x3A;
 				}
 			}
+			if (usb_serial_sof_hook) usb_serial_sof_hook();
 		}
 	}
 }
@@ -18,6 +18,11 @@ int8_t usb_serial_putchar_nowait(uint8_t c);  // transmit a character, do not wa
 int8_t usb_serial_write(const uint8_t *buffer, uint16_t size); // transmit a buffer
 void usb_serial_flush_output(void);	// immediately transmit any buffered output
 
+// optional hook, called once per USB frame (1 ms) from the USB interrupt
+// while configured; define it to feed queued output to
+// usb_serial_putchar_nowait() without blocking the main program
+void usb_serial_sof_hook(void) __attribute__((weak));
+
 // serial parameters
 uint32_t usb_serial_get_baud(void);	// get the baud rate
 uint8_t usb_serial_get_stopbits(void);	// get the number of stop bits
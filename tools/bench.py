@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+"""Run the benchmark firmware in simavr and report cycles per kernel.
+
+The firmware (src/bench/bench.c, built by "make bench" in src/) prints
+"bench <name> <cycles> <calls>" lines on the simavr console. This runs it,
+collects those lines and writes a JSON report. Given a baseline report it
+also prints the change for each kernel, and with --max-regression fails
+when any kernel got slower by more than that percentage.
+
+    cd src && make bench
+    python3 ../tools/bench.py bench.elf -o before.json
+    # ...change something, make bench again...
+    python3 ../tools/bench.py bench.elf -o after.json --baseline before.json
+"""
+
+import argparse
+import json
+import re
+import shutil
+import subprocess
+import sys
+
+F_CPU = 8000000
+
+# Console lines may carry simavr's own prefix or colour codes
+RESULT = re.compile(r"bench (\w+) (\d+) (\d+)")
+DONE = re.compile(r"bench done")
+
+
+def find_simavr(name):
+    for candidate in ([name] if name else ["simavr", "run_avr"]):
+        path = shutil.which(candidate)
+        if path:
+            return path
+    sys.exit("bench: simavr not found; give its path with --simavr")
+
+
+def run(simavr, elf, timeout):
+    """Run the firmware and return {kernel: {"cycles", "calls", "us"}}."""
+    try:
+        proc = subprocess.run([simavr, elf], capture_output=True, text=True,
+                              errors="replace", timeout=timeout)
+    except subprocess.TimeoutExpired:
+        sys.exit(f"bench: {elf} did not finish within {timeout} s")
+
+    output = proc.stdout + proc.stderr
+    if not DONE.search(output):
+        sys.stderr.write(output)
+        sys.exit(f"bench: {elf} stopped before the end of the run")
+
+    kernels = {}
+    for name, cycles, calls in RESULT.findall(output):
+        cycles = int(cycles)
+        kernels[name] = {
+            "cycles": cycles,
+            "calls": int(calls),
+            "us": round(cycles * 1e6 / F_CPU, 2),
+        }
+    return kernels
+
+
+def compare(kernels, baseline, max_regression):
+    """Print the change from baseline; return False if a kernel regressed
+    by more than max_regression percent."""
+    ok = True
+    print(f"{'kernel':<24}{'baseline':>10}{'now':>10}{'change':>9}", file=sys.stderr)
+    for name, result in kernels.items():
+        before = baseline.get(name)
+        if before is None:
+            print(f"{name:<24}{'-':>10}{result['cycles']:>10}{'new':>9}", file=sys.stderr)
+            continue
+        change = (result["cycles"] - before["cycles"]) * 100.0 / max(before["cycles"], 1)
+        flag = ""
+        if max_regression is not None and change > max_regression:
+            flag = "  REGRESSION"
+            ok = False
+        print(f"{name:<24}{before['cycles']:>10}{result['cycles']:>10}{change:>+8.1f}%{flag}",
+              file=sys.stderr)
+    for name in baseline:
+        if name not in kernels:
+            print(f"{name:<24}{baseline[name]['cycles']:>10}{'-':>10}{'gone':>9}", file=sys.stderr)
+    return ok
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("elf", help="benchmark firmware (src/bench.elf)")
+    parser.add_argument("-o", "--output", help="write the JSON report here instead of stdout")
+    parser.add_argument("--baseline", help="JSON report to compare against")
+    parser.add_argument("--max-regression", type=float, metavar="PERCENT",
+                        help="exit 1 if a kernel is this much slower than the baseline")
+    parser.add_argument("--simavr", help="simavr executable (default: simavr or run_avr)")
+    parser.add_argument("--timeout", type=float, default=300, help="seconds (default 300)")
+    args = parser.parse_args()
+
+    kernels = run(find_simavr(args.simavr), args.elf, args.timeout)
+    report = {"f_cpu": F_CPU, "kernels": kernels}
+    text = json.dumps(report, indent=2) + "\n"
+    if args.output:
+        with open(args.output, "w") as f:
+            f.write(text)
+    else:
+        sys.stdout.write(text)
+
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)["kernels"]
+        if not compare(kernels, baseline, args.max_regression):
+            sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
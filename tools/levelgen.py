@@ -0,0 +1,137 @@
+#!/usr/bin/env python3
+"""Compile level text files into PROGMEM level descriptors.
+
+Each file is one level, in the order given on the command line. The format
+is described in src/level.h; the output is C for src/levels.h:
+
+    cd src && make levels
+    python3 ../tools/levelgen.py levels/level1.txt levels/level2.txt > levels.h
+"""
+
+import os
+import sys
+
+# Keep in step with src/level.h and the checks in room_parser_store()
+LCD_X, LCD_Y = 84, 48
+OBJ_SIZE = 5
+STATUS_BAR_HEIGHT = 8
+MAX_WALLS = 8
+MAX_CHEESE = MAX_TRAPS = 5
+MIN_INTERVAL = 100
+
+FIELDS = {"T": 2, "J": 2, "W": 4, "C": 2, "P": 2, "M": 1}
+
+
+class LevelError(Exception):
+    pass
+
+
+def check_position(x, y):
+    if not (x + OBJ_SIZE <= LCD_X and STATUS_BAR_HEIGHT < y and y + OBJ_SIZE <= LCD_Y):
+        raise LevelError("position ({}, {}) is outside the play area".format(x, y))
+
+
+def check_wall(x1, y1, x2, y2):
+    for x, y in ((x1, y1), (x2, y2)):
+        if not (0 <= x < LCD_X and STATUS_BAR_HEIGHT <= y < LCD_Y):
+            raise LevelError("wall end ({}, {}) is off the play area".format(x, y))
+
+
+def check_cap(cap, limit, interval):
+    if not 1 <= cap <= limit:
+        raise LevelError("cap {} is not between 1 and {}".format(cap, limit))
+    check_interval(interval, allow_zero=False)
+
+
+def check_interval(interval, allow_zero):
+    if interval == 0 and allow_zero:
+        return
+    if not MIN_INTERVAL <= interval <= 65535:
+        raise LevelError("interval {} ms is not between {} and 65535".format(interval, MIN_INTERVAL))
+
+
+def parse(path):
+    # Defaults match the built-in levels' fallbacks in the game
+    level = {
+        "tom": (LCD_X - 5, LCD_Y - 9),
+        "jerry": (0, STATUS_BAR_HEIGHT + 1),
+        "cheese": (5, 2000),
+        "traps": (5, 3000),
+        "milk": 0,
+        "walls": [],
+    }
+    with open(path) as f:
+        for number, line in enumerate(f, 1):
+            words = line.split()
+            if not words:
+                continue
+            try:
+                record = words[0]
+                if record not in FIELDS:
+                    raise LevelError("unknown record {!r}".format(record))
+                if len(words) != 1 + FIELDS[record]:
+                    raise LevelError("{} takes {} numbers".format(record, FIELDS[record]))
+                values = [int(word) for word in words[1:]]
+                if record == "T":
+                    check_position(*values)
+                    level["tom"] = tuple(values)
+                elif record == "J":
+                    check_position(*values)
+                    level["jerry"] = tuple(values)
+                elif record == "W":
+                    check_wall(*values)
+                    level["walls"].append(tuple(values))
+                    if len(level["walls"]) > MAX_WALLS:
+                        raise LevelError("more than {} walls".format(MAX_WALLS))
+                elif record == "C":
+                    check_cap(values[0], MAX_CHEESE, values[1])
+                    level["cheese"] = tuple(values)
+                elif record == "P":
+                    check_cap(values[0], MAX_TRAPS, values[1])
+                    level["traps"] = tuple(values)
+                elif record == "M":
+                    check_interval(values[0], allow_zero=True)
+                    level["milk"] = values[0]
+            except (LevelError, ValueError) as e:
+                raise SystemExit("{}:{}: {}".format(path, number, e))
+    return level
+
+
+def emit(levels, paths):
+    out = [
+        "// Generated by tools/levelgen.py from {}; do not edit.".format(
+            ", ".join(os.path.basename(p) for p in paths)),
+        "#ifndef LEVELS_H_",
+        "#define LEVELS_H_",
+        "",
+        "#include <avr/pgmspace.h>",
+        "",
+        '#include "level.h"',
+        "",
+    ]
+    for i, level in enumerate(levels, 1):
+        walls = ", ".join("{{{}, {}, {}, {}}}".format(*w) for w in level["walls"])
+        out.append("const struct level level_{} PROGMEM = {{{}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {{{}}}}};".format(
+            i, level["tom"][0], level["tom"][1], level["jerry"][0], level["jerry"][1],
+            level["cheese"][0], level["traps"][0], level["cheese"][1], level["traps"][1],
+            level["milk"], len(level["walls"]), walls))
+    out += [
+        "",
+        "#define NUM_LEVELS {}".format(len(levels)),
+        "const struct level *const levels[NUM_LEVELS] PROGMEM = {{{}}};".format(
+            ", ".join("&level_{}".format(i) for i in range(1, len(levels) + 1))),
+        "",
+        "#endif",
+    ]
+    return "\n".join(out) + "\n"
+
+
+def main():
+    paths = sys.argv[1:]
+    if not paths:
+        raise SystemExit("usage: levelgen.py LEVEL.txt...")
+    sys.stdout.write(emit([parse(p) for p in paths], paths))
+
+
+if __name__ == "__main__":
+    main()
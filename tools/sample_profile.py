@@ -0,0 +1,127 @@
+#!/usr/bin/env python3
+"""Build a per-function profile from the Teensy's sampling profiler.
+
+Reads the sample records (type 2) from a telemetry capture, looks each
+flash address up in the program's ELF symbol table and prints how many
+samples landed in each function, most first. Build the game with
+SAMPLER=1 and send 'r' to start and stop sampling; everything between
+lands in the capture. Time spent with interrupts off is charged to the
+instruction after it (see src/cab202_teensy/sampler.h).
+
+    cd src && make SAMPLER=1
+    python3 ../tools/sample_profile.py tomjerry.hex.obj capture.bin
+    python3 ../tools/sample_profile.py tomjerry.hex.obj capture.bin --bucket 64
+"""
+
+import argparse
+import bisect
+import collections
+import struct
+import sys
+
+from telemetry_decode import SAMPLES, decode_samples, frames, read_chunks
+
+SHT_SYMTAB = 2
+SHF_EXECINSTR = 0x4
+STT_NOTYPE = 0
+STT_FUNC = 2
+
+
+def read_symbols(path):
+    """Return sorted (address, size, name) for the code symbols in an ELF32 file."""
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:4] != b"\x7fELF" or data[4] != 1:
+        sys.exit("{}: not an ELF32 file".format(path))
+    endian = "<" if data[5] == 1 else ">"
+
+    shoff, = struct.unpack_from(endian + "I", data, 0x20)
+    shentsize, shnum = struct.unpack_from(endian + "HH", data, 0x2E)
+    section = struct.Struct(endian + "IIIIIIIIII")
+    sections = [section.unpack_from(data, shoff + i * shentsize) for i in range(shnum)]
+
+    symbol = struct.Struct(endian + "IIIBBH")
+    symbols = {}
+    for sh_type, sh_link, sh_offset, sh_size in (
+        (s[1], s[6], s[4], s[5]) for s in sections
+    ):
+        if sh_type != SHT_SYMTAB:
+            continue
+        strtab = sections[sh_link][4]
+        for offset in range(sh_offset, sh_offset + sh_size, symbol.size):
+            st_name, value, size, info, _, shndx = symbol.unpack_from(data, offset)
+            if info & 0xF not in (STT_NOTYPE, STT_FUNC) or not 0 < shndx < shnum:
+                continue
+            if not sections[shndx][2] & SHF_EXECINSTR:
+                continue
+            end = data.index(b"\0", strtab + st_name)
+            name = data[strtab + st_name:end].decode("ascii", "replace")
+            if not name or name.startswith(".L"):
+                continue
+            # Prefer a sized FUNC over a label at the same address
+            if value not in symbols or size > symbols[value][0]:
+                symbols[value] = (size, name)
+    return sorted((value, size, name) for value, (size, name) in symbols.items())
+
+
+def symbolize(symbols, pc):
+    """Name the function containing flash byte address pc."""
+    starts = [value for value, _, _ in symbols]
+    i = bisect.bisect_right(starts, pc) - 1
+    if i < 0:
+        return "?"
+    value, size, name = symbols[i]
+    if size and pc >= value + size:
+        return "? ({})".format(name)
+    return name
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("elf", help="the program, e.g. src/tomjerry.hex.obj")
+    parser.add_argument("source", nargs="?", help="serial device or capture file (default stdin)")
+    parser.add_argument("--bucket", type=int, metavar="BYTES",
+                        help="also print a histogram of raw addresses in buckets of this size")
+    parser.add_argument("--top", type=int, default=0, metavar="N", help="print only the first N functions")
+    args = parser.parse_args()
+
+    symbols = read_symbols(args.elf)
+    starts = [value for value, _, _ in symbols]
+    stream = open(args.source, "rb", buffering=0) if args.source else sys.stdin.buffer
+
+    addresses = collections.Counter()
+    try:
+        for kind, payload in frames(read_chunks(stream)):
+            if kind == SAMPLES:
+                addresses.update(decode_samples(payload))
+    except KeyboardInterrupt:
+        pass
+
+    total = sum(addresses.values())
+    if not total:
+        sys.exit("no samples found")
+
+    functions = collections.Counter()
+    for pc, count in addresses.items():
+        functions[symbolize(symbols, pc)] += count
+
+    print("{} samples".format(total))
+    print("{:>8} {:>6}  function".format("samples", "%"))
+    for name, count in functions.most_common(args.top or None):
+        print("{:>8} {:>6.1f}  {}".format(count, 100.0 * count / total, name))
+
+    if args.bucket:
+        buckets = collections.Counter()
+        for pc, count in addresses.items():
+            buckets[pc - pc % args.bucket] += count
+        print()
+        print("{:>6} {:>8} {:>6}  function".format("addr", "samples", "%"))
+        for start in sorted(buckets):
+            count = buckets[start]
+            i = bisect.bisect_right(starts, start) - 1
+            name = symbols[i][2] if i >= 0 else "?"
+            print("{:06x} {:>8} {:>6.1f}  {}".format(start, count, 100.0 * count / total, name))
+
+
+if __name__ == "__main__":
+    main()
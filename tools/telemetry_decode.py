@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+"""Decode the Teensy's binary telemetry stream.
+
+Reads from a serial device or a capture file (or stdin) and prints one line
+per valid frame. Frames are found by their sync byte and CRC, so text such
+as the 'i' state dump in the same stream is skipped. Send 't' to the game
+to start or stop streaming.
+
+Sample records from the sampling profiler ('r', built with SAMPLER=1)
+print as flash addresses; tools/sample_profile.py turns them into a
+per-function profile.
+
+Frame layout (see src/cab202_teensy/telemetry.h):
+    0xA5, length, type, payload[length], crc16 (little endian)
+
+    python3 tools/telemetry_decode.py /dev/ttyACM0
+    python3 tools/telemetry_decode.py capture.bin --csv
+"""
+
+import argparse
+import struct
+import sys
+
+SYNC = 0xA5
+
+# Record types, matching the RECORD_* defines in src/tomjerry.c
+STATE = 1
+SAMPLES = 2
+
+# struct state_record in src/tomjerry.c
+STATE_FORMAT = struct.Struct("<IIBBBhBBBBhhhhHHHH")
+STATE_FIELDS = (
+    "step", "time", "level", "lives", "flags", "score",
+    "cheese", "cheese_collected", "traps", "fireworks",
+    "jerry_x", "jerry_y", "tom_x", "tom_y",
+    "next_cheese", "next_trap", "next_milk", "super_left",
+)
+FIXED_FIELDS = ("jerry_x", "jerry_y", "tom_x", "tom_y")
+FLAGS = ((0x01, "paused"), (0x02, "super"), (0x04, "game_over"))
+
+
+def crc16(data, crc=0xFFFF):
+    """CRC-16 matching avr-libc _crc_ccitt_update()."""
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0x8408 if crc & 1 else crc >> 1
+    return crc
+
+
+def frames(chunks):
+    """Yield (type, payload) for each valid frame in a stream of byte chunks."""
+    buf = bytearray()
+    for chunk in chunks:
+        buf += chunk
+        while True:
+            start = buf.find(SYNC)
+            if start < 0:
+                buf.clear()
+                break
+            del buf[:start]
+            if len(buf) < 3:
+                break
+            length = buf[1]
+            end = 3 + length + 2
+            if len(buf) < end:
+                break
+            body = bytes(buf[1:3 + length])
+            crc = buf[end - 2] | buf[end - 1] << 8
+            if crc16(body) == crc:
+                yield buf[2], bytes(buf[3:3 + length])
+                del buf[:end]
+            else:
+                # Not a frame after all; resynchronise on the next sync byte
+                del buf[:1]
+
+
+def decode_state(payload):
+    if len(payload) != STATE_FORMAT.size:
+        return None
+    record = dict(zip(STATE_FIELDS, STATE_FORMAT.unpack(payload)))
+    for name in FIXED_FIELDS:
+        record[name] /= 256.0
+    return record
+
+
+def decode_samples(payload):
+    """Flash byte addresses from a sample record."""
+    return [pc for (pc,) in struct.iter_unpack("<H", payload[:len(payload) & ~1])]
+
+
+def format_state(record):
+    names = ",".join(name for bit, name in FLAGS if record["flags"] & bit) or "-"
+    return (
+        "step {step} t={time}ms L{level} lives={lives} score={score} "
+        "cheese={cheese}/{cheese_collected} traps={traps} fireworks={fireworks} "
+        "jerry=({jerry_x:.2f},{jerry_y:.2f}) tom=({tom_x:.2f},{tom_y:.2f}) "
+        "next cheese={next_cheese} trap={next_trap} milk={next_milk} "
+        "super={super_left} [{names}]".format(names=names, **record)
+    )
+
+
+def read_chunks(stream):
+    while True:
+        chunk = stream.read1(256) if hasattr(stream, "read1") else stream.read(256)
+        if not chunk:
+            return
+        yield chunk
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("source", nargs="?", help="serial device or capture file (default stdin)")
+    parser.add_argument("--csv", action="store_true", help="print state records as CSV")
+    args = parser.parse_args()
+
+    stream = open(args.source, "rb", buffering=0) if args.source else sys.stdin.buffer
+    if args.csv:
+        print(",".join(STATE_FIELDS))
+
+    try:
+        for kind, payload in frames(read_chunks(stream)):
+            if kind == SAMPLES:
+                if not args.csv:
+                    print("samples " + " ".join("{:04x}".format(pc) for pc in decode_samples(payload)))
+                continue
+            record = decode_state(payload) if kind == STATE else None
+            if record is None:
+                print("type {} ({} bytes): {}".format(kind, len(payload), payload.hex()))
+            elif args.csv:
+                print(",".join(str(record[name]) for name in STATE_FIELDS))
+            else:
+                print(format_state(record))
+            sys.stdout.flush()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()